@@ -0,0 +1,87 @@
+#include "archiveset.h"
+
+ArchiveSet::ArchiveSet():
+m_cache(NULL)
+{
+    
+}
+
+void ArchiveSet::add(const std::string& filename, bool recover)
+{
+    std::unique_ptr<InstallShield> archive(new InstallShield());
+    std::string filepath = filename;
+    
+    if(recover) {
+        archive->recover(filepath);
+    } else {
+        archive->open(filepath);
+    }
+
+    add(std::move(archive));
+}
+
+void ArchiveSet::add(std::unique_ptr<InstallShield> archive)
+{
+    const InstallShield::t_file_map& files = archive->files();
+    
+    if(m_cache) archive->setCache(m_cache);
+    
+    //the index points into the archive's own, which no longer changes once
+    //files() has completed it
+    for(InstallShield::t_file_map::const_iterator it = files.begin(); it != files.end(); it++) {
+        t_member& member = m_index[it->first];
+    
+        member.archive = archive.get();
+        member.entry = &it->second;
+    }
+    
+    m_archives.push_back(std::move(archive));
+}
+
+const ArchiveSet::t_member* ArchiveSet::find(const std::string& name) const
+{
+    t_name_index::const_iterator it = m_index.find(name);
+    
+    return it == m_index.end() ? NULL : &it->second;
+}
+
+MemberCache::t_data ArchiveSet::readFile(const std::string& name) const
+{
+    const t_member* member = find(name);
+    
+    if(!member) return MemberCache::t_data();
+    
+    return member->archive->readFile(name);
+}
+
+int ArchiveSet::decodeFile(const std::string& name, blast_out out, void* how) const
+{
+    const t_member* member = find(name);
+    
+    if(!member) return -10;
+    
+    return member->archive->decodeFile(name, out, how);
+}
+
+bool ArchiveSet::extractAll(const std::string& dir,
+                            const InstallShield::t_extract_options& options) const
+{
+    std::vector<InstallShield::t_member_ref> members;
+    
+    members.reserve(m_index.size());
+    
+    for(t_name_index::const_iterator it = m_index.begin(); it != m_index.end(); it++) {
+        members.push_back(InstallShield::t_member_ref(it->second.archive, it->first));
+    }
+    
+    return InstallShield::extractMembers(members, dir, options);
+}
+
+void ArchiveSet::setCache(MemberCache* cache)
+{
+    m_cache = cache;
+    
+    for(size_t i = 0; i < m_archives.size(); i++) {
+        m_archives[i]->setCache(cache);
+    }
+}
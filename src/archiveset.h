@@ -0,0 +1,55 @@
+/* 
+ * File:   archiveset.h
+ * 
+ * Several archives seen as one, as games ship patches and expansions as
+ * further archives. A member of a later archive hides any of the same name in
+ * the archives before it.
+ */
+
+#ifndef ARCHIVESET_H
+#define	ARCHIVESET_H
+
+#include "isextract.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ArchiveSet
+{
+public:
+    //where a name resolves to
+    struct t_member {
+        const InstallShield* archive;
+        const InstallShield::t_entry* entry;
+    };
+    typedef std::unordered_map<std::string, t_member> t_name_index;
+    
+    ArchiveSet();
+    //open filename, or recover it if recover, and add it over the archives
+    //already in the set, throws if it can't be opened
+    void add(const std::string& filename, bool recover = false);
+    //add an archive that is already open, the set takes it over
+    void add(std::unique_ptr<InstallShield> archive);
+    //in the order they were added
+    const std::vector<std::unique_ptr<InstallShield> >& archives() const { return m_archives; }
+    //every name in the set and the member it resolves to
+    const t_name_index& members() const { return m_index; }
+    //null if no archive has the member
+    const t_member* find(const std::string& name) const;
+    //as InstallShield's, from the archive the name resolves to
+    MemberCache::t_data readFile(const std::string& name) const;
+    int decodeFile(const std::string& name, blast_out out, void* how) const;
+    //extract the member every name resolves to as one job across archives
+    bool extractAll(const std::string& dir, const InstallShield::t_extract_options& options) const;
+    //share decoded members of every archive through cache, which must
+    //outlive this object
+    void setCache(MemberCache* cache);
+private:
+    std::vector<std::unique_ptr<InstallShield> > m_archives;
+    t_name_index m_index;
+    MemberCache* m_cache;
+};
+
+#endif	/* ARCHIVESET_H */
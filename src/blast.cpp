@@ -22,10 +22,29 @@
  *
  * 1.0  12 Feb 2003     - First version
  * 1.1  16 Feb 2003     - Fixed distance check for > 4 GB uncompressed data
+ *
+ * Altered for isextract:
+ *
+ *      - Split the decoding loop out of decomp() into explode(), which
+ *        decomp() calls once it has read the header.  Specializing it for
+ *        each literal mode and dictionary size was measured with make bench
+ *        and gave no gain, so it stays a single loop.
+ *      - Count literals and matches per stream when built with ISX_STATS and
+ *        add them to the run statistics when blast() returns.
+ *      - Added left and in parameters to blast() to provide initial input
+ *        and return unused input, as version 1.3 of blast does, so that the
+ *        end of a stream can be found in data that carries on past it.
+ *      - Made construct() constexpr and build the fixed code tables with it
+ *        at compile time, checked with static_assert, replacing the virgin
+ *        flag that built them on first use and raced between threads.
+ *      - Exported the code length lists as blast_litlen, blast_lenlen and
+ *        blast_distlen for the encoder in tests/blast_tests.cpp, and the
+ *        tables built from them through blast_table() to test them
  */
 
 #include <setjmp.h>             /* for setjmp(), longjmp(), and jmp_buf */
 #include "blast.h"              /* prototype for blast() */
+#include "stats.h"              /* run statistics */
 
 #define local static            /* for local function definitions */
 #define MAXBITS 13              /* maximum code length */
@@ -50,6 +69,13 @@ struct state {
     unsigned next;              /* index of next write location in out[] */
     int first;                  /* true to check distances (for first 4K) */
     unsigned char out[MAXWIN];  /* output buffer and sliding window */
+
+#ifdef ISX_STATS
+    /* symbol counts for the run statistics */
+    unsigned long literals;     /* literals decoded */
+    unsigned long matches;      /* length/distance pairs decoded */
+    unsigned long matched;      /* bytes copied by length/distance pairs */
+#endif
 };
 
 /*
@@ -95,8 +121,8 @@ local int bits(struct state *s, int need)
  * seen in the function decode() below.
  */
 struct huffman {
-    short *count;       /* number of symbols of each length */
-    short *symbol;      /* canonically ordered symbols */
+    const short *count;         /* number of symbols of each length */
+    const short *symbol;        /* canonically ordered symbols */
 };
 
 /*
@@ -120,7 +146,7 @@ struct huffman {
  *   this ordering, the bits pulled during decoding are inverted to apply the
  *   more "natural" ordering starting with all zeros and incrementing.
  */
-local int decode(struct state *s, struct huffman *h)
+local int decode(struct state *s, const struct huffman *h)
 {
     int len;            /* current number of bits in code */
     int code;           /* len bits being decoded */
@@ -129,7 +155,7 @@ local int decode(struct state *s, struct huffman *h)
     int index;          /* index of first code of length len in symbol table */
     int bitbuf;         /* bits from stream */
     int left;           /* bits left in next or left to process */
-    short *next;        /* next number of codes */
+    const short *next;  /* next number of codes */
 
     bitbuf = s->bitbuf;
     left = s->bitcnt;
@@ -181,14 +207,19 @@ local int decode(struct state *s, struct huffman *h)
  * enough bits will resolve to a symbol.  If the return value is positive, then
  * it is possible for decode() using that table to return an error for received
  * codes past the end of the incomplete lengths.
+ *
+ * construct() is constexpr so that the fixed tables below are built by the
+ * compiler, hence every local is initialized and count[] and symbol[] are
+ * passed separately rather than as a struct huffman of const pointers.
  */
-local int construct(struct huffman *h, const unsigned char *rep, int n)
+local constexpr int construct(short *count, short *symbols,
+                              const unsigned char *rep, int n)
 {
-    int symbol;         /* current symbol when stepping through length[] */
-    int len;            /* current length when stepping through h->count[] */
-    int left;           /* number of possible codes left of current length */
-    short offs[MAXBITS+1];      /* offsets in symbol table for each length */
-    short length[256];  /* code lengths */
+    int symbol = 0;     /* current symbol when stepping through length[] */
+    int len = 0;        /* current length when stepping through count[] */
+    int left = 0;       /* number of possible codes left of current length */
+    short offs[MAXBITS+1] = {0};    /* offsets in symbol table for each length */
+    short length[256] = {0};        /* code lengths */
 
     /* convert compact repeat counts into symbol bit length list */
     symbol = 0;
@@ -204,24 +235,24 @@ local int construct(struct huffman *h, const unsigned char *rep, int n)
 
     /* count number of codes of each length */
     for (len = 0; len <= MAXBITS; len++)
-        h->count[len] = 0;
+        count[len] = 0;
     for (symbol = 0; symbol < n; symbol++)
-        (h->count[length[symbol]])++;   /* assumes lengths are within bounds */
-    if (h->count[0] == n)               /* no codes! */
+        (count[length[symbol]])++;      /* assumes lengths are within bounds */
+    if (count[0] == n)                  /* no codes! */
         return 0;                       /* complete, but decode() will fail */
 
     /* check for an over-subscribed or incomplete set of lengths */
     left = 1;                           /* one possible code of zero length */
     for (len = 1; len <= MAXBITS; len++) {
         left <<= 1;                     /* one more bit, double codes left */
-        left -= h->count[len];          /* deduct count from possible codes */
+        left -= count[len];             /* deduct count from possible codes */
         if (left < 0) return left;      /* over-subscribed--return negative */
     }                                   /* left > 0 means incomplete */
 
     /* generate offsets into symbol table for each length for sorting */
     offs[1] = 0;
     for (len = 1; len < MAXBITS; len++)
-        offs[len + 1] = offs[len] + h->count[len];
+        offs[len + 1] = offs[len] + count[len];
 
     /*
      * put symbols in table sorted by length, by symbol order within each
@@ -229,12 +260,101 @@ local int construct(struct huffman *h, const unsigned char *rep, int n)
      */
     for (symbol = 0; symbol < n; symbol++)
         if (length[symbol] != 0)
-            h->symbol[offs[length[symbol]]++] = symbol;
+            symbols[offs[length[symbol]]++] = symbol;
 
     /* return zero for complete set, positive for incomplete set */
     return left;
 }
 
+/*
+ * Memory for the decoding tables of a code of N symbols, filled in by
+ * construct() at compile time.  left is what construct() returned.
+ */
+template <int N>
+struct table {
+    short count[MAXBITS+1];     /* number of symbols of each length */
+    short symbol[N];            /* canonically ordered symbols */
+    int left;                   /* zero for a complete code */
+};
+
+template <int N, int R>
+local constexpr table<N> tables(const unsigned char (&rep)[R])
+{
+    table<N> h = {};
+
+    h.left = construct(h.count, h.symbol, rep, R);
+    return h;
+}
+
+/* number of symbols with a length, zero included, for the checks below */
+local constexpr int total(const short *count)
+{
+    int n = 0;
+    for (int len = 0; len <= MAXBITS; len++)
+        n += count[len];
+    return n;
+}
+
+/*
+ * Fixed Huffman codes and length tables, shared by every explode()
+ * call.  The code tables are constant, so they can be read from
+ * any number of threads with no set up.
+ */
+    /* bit lengths of literal codes */
+constexpr unsigned char blast_litlen[] = {
+    11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
+    9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
+    7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
+    8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
+    44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
+    44, 173};
+    /* bit lengths of length codes 0..15 */
+constexpr unsigned char blast_lenlen[] = {2, 35, 36, 53, 38, 23};
+    /* bit lengths of distance codes 0..63 */
+constexpr unsigned char blast_distlen[] = {2, 20, 53, 230, 247, 151, 248};
+local constexpr table<256> littab = tables<256>(blast_litlen);    /* litcode memory */
+local constexpr table<16> lentab = tables<16>(blast_lenlen);      /* lencode memory */
+local constexpr table<64> disttab = tables<64>(blast_distlen);    /* distcode memory */
+local const struct huffman litcode = {littab.count, littab.symbol};  /* literal code */
+local const struct huffman lencode = {lentab.count, lentab.symbol};  /* length code */
+local const struct huffman distcode = {disttab.count, disttab.symbol}; /* distance code */
+
+/*
+ * Each code must cover exactly its symbols and be complete, so that decode()
+ * can't run out of codes on them.  tests/blast_tests compares the tables
+ * entry by entry with those the original construct() builds at run time.
+ */
+static_assert(littab.left == 0 && total(littab.count) == 256,
+              "literal code is not complete over 256 symbols");
+static_assert(lentab.left == 0 && total(lentab.count) == 16,
+              "length code is not complete over 16 symbols");
+static_assert(disttab.left == 0 && total(disttab.count) == 64,
+              "distance code is not complete over 64 symbols");
+/* See comments in blast.h */
+int blast_table(int code, const short **count, const short **symbol)
+{
+    switch (code) {
+    case 0:
+        *count = littab.count;
+        *symbol = littab.symbol;
+        return 256;
+    case 1:
+        *count = lentab.count;
+        *symbol = lentab.symbol;
+        return 16;
+    case 2:
+        *count = disttab.count;
+        *symbol = disttab.symbol;
+        return 64;
+    }
+    return 0;
+}
+
+local const short base[16] = {      /* base for length codes */
+    3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+local const char extra[16] = {      /* extra bits for length codes */
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+
 /*
  * Decode PKWare Compression Library stream.
  *
@@ -272,53 +392,18 @@ local int construct(struct huffman *h, const unsigned char *rep, int n)
  *   twelve copies the last four bytes three times.  A simple forward copy
  *   ignoring whether the length is greater than the distance or not implements
  *   this correctly.
+ *
+ * - The literal mode and dictionary size come from the header read by
+ *   decomp(), lit true if literals are coded and dict log2(dictionary size)
+ *   - 6.
  */
-local int decomp(struct state *s)
+local int explode(struct state *s, int lit, int dict)
 {
-    int lit;            /* true if literals are coded */
-    int dict;           /* log2(dictionary size) - 6 */
     int symbol;         /* decoded symbol, extra bits for distance */
     int len;            /* length for copy */
     int dist;           /* distance for copy */
     int copy;           /* copy counter */
     unsigned char *from, *to;   /* copy pointers */
-    static int virgin = 1;                              /* build tables once */
-    static short litcnt[MAXBITS+1], litsym[256];        /* litcode memory */
-    static short lencnt[MAXBITS+1], lensym[16];         /* lencode memory */
-    static short distcnt[MAXBITS+1], distsym[64];       /* distcode memory */
-    static struct huffman litcode = {litcnt, litsym};   /* length code */
-    static struct huffman lencode = {lencnt, lensym};   /* length code */
-    static struct huffman distcode = {distcnt, distsym};/* distance code */
-        /* bit lengths of literal codes */
-    static const unsigned char litlen[] = {
-        11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
-        9, 7, 6, 7, 8, 7, 6, 55, 8, 23, 24, 12, 11, 7, 9, 11, 12, 6, 7, 22, 5,
-        7, 24, 6, 11, 9, 6, 7, 22, 7, 11, 38, 7, 9, 8, 25, 11, 8, 11, 9, 12,
-        8, 12, 5, 38, 5, 38, 5, 11, 7, 5, 6, 21, 6, 10, 53, 8, 7, 24, 10, 27,
-        44, 253, 253, 253, 252, 252, 252, 13, 12, 45, 12, 45, 12, 61, 12, 45,
-        44, 173};
-        /* bit lengths of length codes 0..15 */
-    static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
-        /* bit lengths of distance codes 0..63 */
-    static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
-    static const short base[16] = {     /* base for length codes */
-        3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
-    static const char extra[16] = {     /* extra bits for length codes */
-        0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
-
-    /* set up decoding tables (once--might not be thread-safe) */
-    if (virgin) {
-        construct(&litcode, litlen, sizeof(litlen));
-        construct(&lencode, lenlen, sizeof(lenlen));
-        construct(&distcode, distlen, sizeof(distlen));
-        virgin = 0;
-    }
-
-    /* read header */
-    lit = bits(s, 8);
-    if (lit > 1) return -1;
-    dict = bits(s, 8);
-    if (dict < 4 || dict > 6) return -2;
 
     /* decode literals and length/distance pairs */
     do {
@@ -329,19 +414,28 @@ local int decomp(struct state *s)
             if (len == 519) break;              /* end code */
 
             /* get distance */
-            symbol = len == 2 ? 2 : dict;
-            dist = decode(s, &distcode) << symbol;
-            dist += bits(s, symbol);
+            if (len == 2) {
+                dist = decode(s, &distcode) << 2;
+                dist += bits(s, 2);
+            }
+            else {
+                dist = decode(s, &distcode) << dict;
+                dist += bits(s, dict);
+            }
             dist++;
-            if (s->first && dist > s->next)
+            if (s->first && (unsigned)dist > s->next)
                 return -3;              /* distance too far back */
+#ifdef ISX_STATS
+            s->matches++;
+            s->matched += len;
+#endif
 
             /* copy length bytes from distance bytes back */
             do {
                 to = s->out + s->next;
                 from = to - dist;
                 copy = MAXWIN;
-                if (s->next < dist) {
+                if (s->next < (unsigned)dist) {
                     from += copy;
                     copy = dist;
                 }
@@ -363,6 +457,9 @@ local int decomp(struct state *s)
             /* get literal and write it */
             symbol = lit ? decode(s, &litcode) : bits(s, 8);
             s->out[s->next++] = symbol;
+#ifdef ISX_STATS
+            s->literals++;
+#endif
             if (s->next == MAXWIN) {
                 if (s->outfun(s->outhow, s->out, s->next)) return 1;
                 s->next = 0;
@@ -373,8 +470,27 @@ local int decomp(struct state *s)
     return 0;
 }
 
+/*
+ * Read the PKWare Compression Library stream header and decode the rest of
+ * the stream with explode().
+ */
+local int decomp(struct state *s)
+{
+    int lit;            /* true if literals are coded */
+    int dict;           /* log2(dictionary size) - 6 */
+
+    /* read header */
+    lit = bits(s, 8);
+    if (lit > 1) return -1;
+    dict = bits(s, 8);
+    if (dict < 4 || dict > 6) return -2;
+
+    return explode(s, lit, dict);
+}
+
 /* See comments in blast.h */
-int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow)
+int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow,
+          unsigned *left, unsigned char **in)
 {
     struct state s;             /* input/output state */
     int err;                    /* return value */
@@ -382,7 +498,12 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow)
     /* initialize input state */
     s.infun = infun;
     s.inhow = inhow;
-    s.left = 0;
+    if (left != NULL && *left) {
+        s.left = *left;
+        s.in = *in;
+    }
+    else
+        s.left = 0;
     s.bitbuf = 0;
     s.bitcnt = 0;
 
@@ -391,6 +512,11 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow)
     s.outhow = outhow;
     s.next = 0;
     s.first = 1;
+#ifdef ISX_STATS
+    s.literals = 0;
+    s.matches = 0;
+    s.matched = 0;
+#endif
 
     /* return if bits() or decode() tries to read past available input */
     if (setjmp(s.env) != 0)             /* if came back here via longjmp(), */
@@ -401,6 +527,17 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow)
     /* write any leftover output and update the error code if needed */
     if (err != 1 && s.next && s.outfun(s.outhow, s.out, s.next) && err == 0)
         err = 1;
+
+    /* return unused input */
+    if (left != NULL)
+        *left = s.left;
+    if (in != NULL)
+        *in = s.in;
+
+    STAT_ADD(STAT_LITERALS, s.literals);
+    STAT_ADD(STAT_MATCHES, s.matches);
+    STAT_ADD(STAT_MATCH_BYTES, s.matched);
+    STAT_ADD(STAT_BYTES_DECODED, s.literals + s.matched);
     return err;
 }
 
@@ -430,7 +567,7 @@ int main(void)
     int ret, n;
 
     /* decompress to stdout */
-    ret = blast(inf, stdin, outf, stdout);
+    ret = blast(inf, stdin, outf, stdout, NULL, NULL);
     if (ret != 0) fprintf(stderr, "blast error: %d\n", ret);
 
     /* see if there are any leftover bytes */
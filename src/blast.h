@@ -38,7 +38,8 @@ typedef int (*blast_out)(void *how, unsigned char *buf, unsigned len);
  */
 
 
-int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow);
+int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow,
+          unsigned *left, unsigned char **in);
 /* Decompress input to output using the provided infun() and outfun() calls.
  * On success, the return value of blast() is zero.  If there is an error in
  * the source data, i.e. it is not in the proper format, then a negative value
@@ -57,6 +58,13 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow);
  * is for use by the application to pass an output descriptor to outfun(), if
  * desired.
  *
+ * If left and in are not NULL and *left is not zero when blast() is called,
+ * then the *left bytes at *in are consumed before infun() is used.  If left
+ * and in are not NULL, then on return *left is set to the number of input
+ * bytes that infun() provided but blast() did not use, and *in points to the
+ * first of them.  This allows the end of a stream to be found when the input
+ * carries on past it.
+ *
  * The return codes are:
  *
  *   2:  ran out of input before completing decompression
@@ -68,4 +76,22 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow);
  *
  * At the bottom of blast.c is an example program that uses blast() that can be
  * compiled to produce a command-line decompression filter by defining TEST.
+ */
+
+
+extern const unsigned char blast_litlen[98];
+extern const unsigned char blast_lenlen[6];
+extern const unsigned char blast_distlen[7];
+/* Bit lengths of the fixed literal, length and distance codes blast() decodes,
+ * compacted as runs: the low four bits of each byte are a code length and the
+ * high four bits one less than the number of symbols in a row that have it.
+ * These are what an encoder needs to write streams for blast().
+ */
+
+
+int blast_table(int code, const short **count, const short **symbol);
+/* The decoding tables blast() built from those lengths at compile time, for
+ * the literal (0), length (1) or distance (2) code: count[0..13] is the number
+ * of symbols of each code length and symbol[] the symbols in canonical order.
+ * Returns the number of symbols in the code, or zero for any other code.
  */
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "cache.h"
+#include "stats.h"
+
+#include <functional>
+
+MemberCache::MemberCache(uint64_t budget):
+m_budget(budget),
+m_used(0),
+m_next(0)
+{
+    
+}
+
+MemberCache::~MemberCache()
+{
+    
+}
+
+std::string MemberCache::key(const std::string& archive, const std::string& member)
+{
+    //archive identities and member names never contain a nul
+    return archive + '\0' + member;
+}
+
+MemberCache::t_shard& MemberCache::shardFor(const std::string& key)
+{
+    return m_shards[std::hash<std::string>()(key) % SHARDS];
+}
+
+MemberCache::t_data MemberCache::find(const std::string& key)
+{
+    t_shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    
+    std::unordered_map<std::string, t_lru::iterator>::iterator it = shard.index.find(key);
+    
+    if(it == shard.index.end()) {
+        STAT_ADD(STAT_CACHE_MISSES, 1);
+        return t_data();
+    }
+    
+    STAT_ADD(STAT_CACHE_HITS, 1);
+    
+    //move to the front of the lru list
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    
+    return it->second->second;
+}
+
+void MemberCache::evict(t_shard& shard, size_t keep)
+{
+    while(m_used > m_budget && shard.lru.size() > keep) {
+        m_used -= shard.lru.back().second->size();
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+}
+
+void MemberCache::insert(const std::string& key, const t_data& data)
+{
+    t_shard& shard = shardFor(key);
+    uint64_t size = data->size();
+    
+    //anything larger than the budget would just flush the cache
+    if(size > m_budget) return;
+    
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+    
+        //another thread may have decoded the same member meanwhile
+        if(shard.index.find(key) != shard.index.end()) return;
+    
+        shard.lru.push_front(t_item(key, data));
+        shard.index[key] = shard.lru.begin();
+        m_used += size;
+    
+        //make room from this shard's own least recently used entries first
+        evict(shard, 1);
+    }
+    
+    //then from the other shards in turn, holding one lock at a time so
+    //inserts into different shards can't deadlock. Starting from a rotating
+    //shard spreads the evictions.
+    for(unsigned i = 0; i < SHARDS && m_used > m_budget; i++) {
+        t_shard& other = m_shards[m_next++ % SHARDS];
+    
+        if(&other == &shard) continue;
+    
+        std::lock_guard<std::mutex> guard(other.lock);
+        evict(other, 0);
+    }
+}
+
+void MemberCache::clear()
+{
+    for(unsigned i = 0; i < SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(m_shards[i].lock);
+        
+        while(!m_shards[i].lru.empty()) {
+            m_used -= m_shards[i].lru.back().second->size();
+            m_shards[i].lru.pop_back();
+        }
+    
+        m_shards[i].index.clear();
+    }
+}
+
+uint64_t MemberCache::size() const
+{
+    return m_used;
+}
@@ -0,0 +1,69 @@
+/* 
+ * File:   cache.h
+ * 
+ * LRU cache of decoded archive members bounded by a byte budget.
+ */
+
+#ifndef CACHE_H
+#define	CACHE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+class MemberCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char> > t_data;
+    
+    explicit MemberCache(uint64_t budget);
+    ~MemberCache();
+    
+    //key for a member of the archive identified by archive
+    static std::string key(const std::string& archive, const std::string& member);
+    
+    //null if not cached, a hit also marks the entry most recently used
+    t_data find(const std::string& key);
+    void insert(const std::string& key, const t_data& data);
+    void clear();
+    uint64_t size() const;
+    uint64_t budget() const { return m_budget; }
+    //false for members too large to ever be kept
+    bool cacheable(uint64_t size) const { return size <= m_budget; }
+private:
+    typedef std::pair<std::string, t_data> t_item;
+    typedef std::list<t_item> t_lru;
+    
+    //the key space is split over shards each with their own lock, so lookups
+    //for different members rarely contend. The budget is shared, a member
+    //may take all of it.
+    struct t_shard {
+        mutable std::mutex lock;
+        t_lru lru;
+        std::unordered_map<std::string, t_lru::iterator> index;
+    };
+    
+    static const unsigned SHARDS = 16;
+    
+    t_shard& shardFor(const std::string& key);
+    //drop the least recently used entries of shard, whose lock is held, while
+    //over budget and it has more than keep entries
+    void evict(t_shard& shard, size_t keep);
+    
+    uint64_t m_budget;
+    std::atomic<uint64_t> m_used;
+    std::atomic<unsigned> m_next;   //shard to evict from after the inserting one
+    t_shard m_shards[SHARDS];
+};
+
+#endif	/* CACHE_H */
@@ -0,0 +1,134 @@
+#include "diff.h"
+#include "threadpool.h"
+#include "xxhash.h"
+
+#include <cstring>
+#include <functional>
+#include <memory>
+
+//a member of either archive and, once compared, how it differs if it does
+struct t_diff_job {
+    const InstallShield* from;
+    const InstallShield* to;
+    std::string name;
+    bool content;
+    bool differs;
+    t_diff_kind kind;
+};
+
+//true if the len bytes at a in one and at b in two are the same
+static bool sameBytes(const Source& one, uint64_t a, const Source& two, uint64_t b, uint64_t len)
+{
+    unsigned char left[65536];
+    unsigned char right[65536];
+    
+    while(len) {
+        size_t want = len < sizeof(left) ? len : sizeof(left);
+    
+        if(one.read(a, left, want) != want || two.read(b, right, want) != want) return false;
+        if(memcmp(left, right, want) != 0) return false;
+    
+        a += want;
+        b += want;
+        len -= want;
+    }
+    
+    return true;
+}
+
+static void compareMember(t_diff_job* job)
+{
+    const InstallShield::t_entry* a = job->from->findFile(job->name);
+    const InstallShield::t_entry* b = job->to->findFile(job->name);
+    XXH64 hash_a;
+    XXH64 hash_b;
+    
+    job->differs = true;
+    job->kind = DIFF_CHANGED;
+    
+    //different sizes can't be the same content however it was compressed
+    if(a->uncompressed_size != b->uncompressed_size) return;
+    
+    if(a->compressed_size == b->compressed_size
+       && sameBytes(*job->from->source(), job->from->dataOffset(*a),
+                    *job->to->source(), job->to->dataOffset(*b), a->compressed_size)) {
+        job->differs = a->datetime != b->datetime;
+        job->kind = DIFF_TIME;
+        return;
+    }
+    
+    if(!job->content) return;
+    
+    //the same content compressed with other settings or another compressor
+    if(job->from->decodeFile(job->name, XXH64::sink, &hash_a) == 0
+       && job->to->decodeFile(job->name, XXH64::sink, &hash_b) == 0
+       && hash_a.digest() == hash_b.digest()) {
+        job->kind = DIFF_REPACKED;
+    }
+}
+
+std::vector<t_member_diff> diffArchives(const InstallShield& from, const InstallShield& to,
+                                        bool content, unsigned threads)
+{
+    InstallShield::t_file_map::const_iterator a = from.files().begin();
+    InstallShield::t_file_map::const_iterator b = to.files().begin();
+    std::vector<t_diff_job> jobs;
+    std::vector<t_member_diff> diffs;
+    std::unique_ptr<ThreadPool> pool;
+    
+    //both indexes are sorted by name, walk them side by side
+    while(a != from.files().end() || b != to.files().end()) {
+        t_diff_job job;
+    
+        job.from = &from;
+        job.to = &to;
+        job.content = content;
+        job.differs = true;
+    
+        if(b == to.files().end() || (a != from.files().end() && a->first < b->first)) {
+            job.name = a->first;
+            job.kind = DIFF_REMOVED;
+            a++;
+        } else if(a == from.files().end() || b->first < a->first) {
+            job.name = b->first;
+            job.kind = DIFF_ADDED;
+            b++;
+        } else {
+            job.name = a->first;
+            job.differs = false;
+            job.kind = DIFF_CHANGED;
+            a++;
+            b++;
+        }
+    
+        jobs.push_back(job);
+    }
+    
+    if(threads != 1) pool.reset(new ThreadPool(threads));
+    
+    //each task compares one pair in place, so it gets the job's address
+    {
+        TaskGroup group(pool.get());
+    
+        //members in only one of the archives need no comparing
+        for(size_t i = 0; i < jobs.size(); i++) {
+            if(jobs[i].differs) continue;
+    
+            group.submit(std::bind(compareMember, &jobs[i]));
+        }
+    
+        group.wait();
+    }
+    
+    for(size_t i = 0; i < jobs.size(); i++) {
+        if(!jobs[i].differs) continue;
+    
+        t_member_diff diff;
+    
+        diff.name = jobs[i].name;
+        diff.kind = jobs[i].kind;
+        diffs.push_back(diff);
+    }
+    
+    return diffs;
+}
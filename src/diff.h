@@ -0,0 +1,37 @@
+/* 
+ * File:   diff.h
+ * 
+ * What changed between two versions of an archive, from their indexes and
+ * compressed data, decoding only where asked to look at the content.
+ */
+
+#ifndef DIFF_H
+#define	DIFF_H
+
+#include "isextract.h"
+
+#include <string>
+#include <vector>
+
+enum t_diff_kind {
+    DIFF_REMOVED,   //only in the first archive
+    DIFF_ADDED,     //only in the second
+    DIFF_CHANGED,   //different content or, unless it was decoded, compressed data
+    DIFF_REPACKED,  //compressed differently to the same content
+    DIFF_TIME       //the same data with a different datetime
+};
+
+struct t_member_diff {
+    std::string name;
+    t_diff_kind kind;
+};
+
+//compare the members of from and to by name, sizes and datetime, then the
+//compressed data of those that could still be the same. With content, members
+//whose compressed data differs are decoded to tell a change from a repack.
+//Comparisons run on threads workers, 0 for one per cpu. Returns the members
+//that differ in name order.
+std::vector<t_member_diff> diffArchives(const InstallShield& from, const InstallShield& to,
+                                        bool content, unsigned threads);
+
+#endif	/* DIFF_H */
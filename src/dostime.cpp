@@ -23,6 +23,18 @@
 
 #include "dostime.h"
 
+/* localtime() shares one result buffer between threads, use the reentrant
+   variants since members are extracted in parallel.  */
+static void
+local_time (const time_t *time, struct tm *result)
+{
+#ifdef _WIN32
+  localtime_s (result, time);
+#else
+  localtime_r (time, result);
+#endif
+}
+
 /*
  * The specification to which this was written.  From Joe Buck.
  * The DOS format appears to have only 2 second resolution.  It is an
@@ -46,7 +58,7 @@ dos2unixtime (unsigned long dostime)
   time_t now = time (NULL);
 
   /* Call localtime to initialize timezone in TIME.  */
-  ltime = *localtime (&now);
+  local_time (&now, &ltime);
 
   ltime.tm_year = (dostime >> 25) + 80;
   ltime.tm_mon = ((dostime >> 21) & 0x0f) - 1;
@@ -68,7 +80,7 @@ dos2struct(unsigned long dostime, struct tm* ltime)
   time_t now = time (NULL);
 
   /* Call localtime to initialize timezone in TIME.  */
-  *ltime = *localtime (&now);
+  local_time (&now, ltime);
 
   ltime->tm_year = (dostime >> 25) + 80;
   ltime->tm_mon = ((dostime >> 21) & 0x0f) - 1;
@@ -87,8 +99,12 @@ dos2struct(unsigned long dostime, struct tm* ltime)
 unsigned long
 unix2dostime (time_t *time)
 {
-  struct tm *ltime = localtime (time);
-  int year = ltime->tm_year - 80;
+  struct tm ltm;
+  struct tm *ltime = &ltm;
+  int year;
+
+  local_time (time, ltime);
+  year = ltime->tm_year - 80;
   if (year < 0)
     year = 0;
 
@@ -0,0 +1,269 @@
+#include "fusefs.h"
+
+#ifdef HAVE_FUSE
+
+#define FUSE_USE_VERSION 26
+
+#include "threadpool.h"
+#include "dostime.h"
+
+#include <fuse.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+//a member being decoded, readers wait on it for the range they need
+struct t_stream {
+    std::mutex lock;
+    std::condition_variable progress;
+    std::shared_ptr<std::vector<unsigned char> > data;
+    bool done;
+    bool failed;
+};
+
+//what an open file reads from, a cached member or one still decoding
+struct t_handle {
+    MemberCache::t_data data;
+    std::shared_ptr<t_stream> stream;
+};
+
+struct t_mount {
+    const InstallShield* archive;
+    MemberCache* cache;
+    unsigned threads;
+    ThreadPool* pool;
+    std::map<std::string, time_t> mtimes;
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<t_stream> > streams;
+};
+
+static t_mount* mountState()
+{
+    return (t_mount *)fuse_get_context()->private_data;
+}
+
+static int streamf(void *how, unsigned char *buf, unsigned len)
+{
+    t_stream* stream = (t_stream *)how;
+    
+    {
+        std::lock_guard<std::mutex> guard(stream->lock);
+        stream->data->insert(stream->data->end(), buf, buf + len);
+    }
+    
+    stream->progress.notify_all();
+    
+    return 0;
+}
+
+static void decodeStream(t_mount* m, const std::string& name, std::shared_ptr<t_stream> stream)
+{
+    int rv = m->archive->decodeFile(name, streamf, stream.get());
+    
+    {
+        std::lock_guard<std::mutex> guard(stream->lock);
+        stream->done = true;
+        stream->failed = rv != 0;
+    }
+    
+    stream->progress.notify_all();
+    
+    //later opens are served from the cache, readers that already have the
+    //stream keep their reference to the same buffer
+    if(rv == 0) m->cache->insert(MemberCache::key(m->archive->identity(), name), stream->data);
+    
+    std::lock_guard<std::mutex> guard(m->lock);
+    m->streams.erase(name);
+}
+
+static void* isfs_init(struct fuse_conn_info*)
+{
+    t_mount* m = mountState();
+    
+    //started here rather than before fuse_main, which may fork
+    m->pool = new ThreadPool(m->threads);
+    
+    return m;
+}
+
+static void isfs_destroy(void* data)
+{
+    t_mount* m = (t_mount *)data;
+    
+    delete m->pool;
+    m->pool = NULL;
+}
+
+static int isfs_getattr(const char* path, struct stat* st)
+{
+    t_mount* m = mountState();
+    const InstallShield::t_entry* entry;
+    std::map<std::string, time_t>::const_iterator mtime;
+    
+    memset(st, 0, sizeof(*st));
+    
+    if(strcmp(path, "/") == 0) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        return 0;
+    }
+    
+    entry = m->archive->findFile(path + 1);
+    
+    if(!entry) return -ENOENT;
+    
+    mtime = m->mtimes.find(path + 1);
+    
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_size = entry->uncompressed_size;
+    st->st_atime = st->st_mtime = st->st_ctime = mtime->second;
+    
+    return 0;
+}
+
+static int isfs_readdir(const char* path, void* buf, fuse_fill_dir_t filler,
+                        off_t, struct fuse_file_info*)
+{
+    t_mount* m = mountState();
+    
+    if(strcmp(path, "/") != 0) return -ENOENT;
+    
+    filler(buf, ".", NULL, 0);
+    filler(buf, "..", NULL, 0);
+    
+    for(InstallShield::t_file_map::const_iterator it = m->archive->files().begin();
+        it != m->archive->files().end(); it++) {
+        if(filler(buf, it->first.c_str(), NULL, 0)) break;
+    }
+    
+    return 0;
+}
+
+static int isfs_open(const char* path, struct fuse_file_info* fi)
+{
+    t_mount* m = mountState();
+    std::string name = path + 1;
+    const InstallShield::t_entry* entry = m->archive->findFile(name);
+    std::unique_ptr<t_handle> handle(new t_handle);
+    
+    if(!entry) return -ENOENT;
+    if((fi->flags & O_ACCMODE) != O_RDONLY) return -EACCES;
+    
+    {
+        std::lock_guard<std::mutex> guard(m->lock);
+        std::map<std::string, std::shared_ptr<t_stream> >::iterator it = m->streams.find(name);
+        
+        //join a decode already under way, else try the cache, else start one
+        if(it != m->streams.end()) {
+            handle->stream = it->second;
+        } else {
+            handle->data = m->cache->find(MemberCache::key(m->archive->identity(), name));
+            
+            if(!handle->data) {
+                handle->stream.reset(new t_stream);
+                handle->stream->data.reset(new std::vector<unsigned char>());
+                handle->stream->data->reserve(entry->uncompressed_size);
+                handle->stream->done = false;
+                handle->stream->failed = false;
+                
+                m->streams[name] = handle->stream;
+                m->pool->submit(std::bind(decodeStream, m, name, handle->stream));
+            }
+        }
+    }
+    
+    fi->fh = reinterpret_cast<uint64_t>(handle.release());
+    fi->keep_cache = 1;
+    
+    return 0;
+}
+
+static int copyOut(const std::vector<unsigned char>& data, char* buf, size_t size, off_t offset)
+{
+    if(uint64_t(offset) >= data.size()) return 0;
+    
+    if(size > data.size() - offset) size = data.size() - offset;
+    
+    memcpy(buf, &data[offset], size);
+    
+    return size;
+}
+
+static int isfs_read(const char*, char* buf, size_t size, off_t offset,
+                     struct fuse_file_info* fi)
+{
+    t_handle* handle = reinterpret_cast<t_handle*>(fi->fh);
+    
+    if(handle->data) return copyOut(*handle->data, buf, size, offset);
+    
+    //wait only until the requested range is decoded, so sequential readers
+    //are fed while the rest of the member is still being decoded
+    t_stream& stream = *handle->stream;
+    uint64_t want = uint64_t(offset) + size;
+    std::unique_lock<std::mutex> guard(stream.lock);
+    
+    while(!stream.done && stream.data->size() < want) stream.progress.wait(guard);
+    
+    if(stream.failed && stream.data->size() < want) return -EIO;
+    
+    return copyOut(*stream.data, buf, size, offset);
+}
+
+static int isfs_release(const char*, struct fuse_file_info* fi)
+{
+    delete reinterpret_cast<t_handle*>(fi->fh);
+    
+    return 0;
+}
+
+int mountArchive(const InstallShield& archive, const std::string& mountpoint,
+                 MemberCache& cache, unsigned threads, bool foreground)
+{
+    struct fuse_operations ops;
+    std::vector<char*> argv;
+    t_mount m;
+    
+    m.archive = &archive;
+    m.cache = &cache;
+    m.threads = threads;
+    m.pool = NULL;
+    
+    //getattr is hot, work the times out once up front
+    for(InstallShield::t_file_map::const_iterator it = archive.files().begin();
+        it != archive.files().end(); it++) {
+        m.mtimes[it->first] = dos2unixtime(it->second.datetime);
+    }
+    
+    memset(&ops, 0, sizeof(ops));
+    ops.init = isfs_init;
+    ops.destroy = isfs_destroy;
+    ops.getattr = isfs_getattr;
+    ops.readdir = isfs_readdir;
+    ops.open = isfs_open;
+    ops.read = isfs_read;
+    ops.release = isfs_release;
+    
+    argv.push_back(const_cast<char*>("isextract"));
+    argv.push_back(const_cast<char*>(mountpoint.c_str()));
+    argv.push_back(const_cast<char*>("-o"));
+    argv.push_back(const_cast<char*>("ro,fsname=isextract"));
+    
+    if(foreground) argv.push_back(const_cast<char*>("-f"));
+    
+    return fuse_main(argv.size(), &argv[0], &ops, &m);
+}
+
+#else
+
+int mountArchive(const InstallShield&, const std::string&, MemberCache&, unsigned, bool)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,21 @@
+/* 
+ * File:   fusefs.h
+ * 
+ * Read only FUSE filesystem presenting the members of an archive as files.
+ */
+
+#ifndef FUSEFS_H
+#define	FUSEFS_H
+
+#include "isextract.h"
+#include "cache.h"
+
+#include <string>
+
+//mount archive at mountpoint and serve it until unmounted. Members are
+//decoded on first open by threads workers and kept in cache. Returns
+//nonzero on failure, -1 when built without FUSE support.
+int mountArchive(const InstallShield& archive, const std::string& mountpoint,
+                 MemberCache& cache, unsigned threads, bool foreground);
+
+#endif	/* FUSEFS_H */
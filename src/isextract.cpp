@@ -1,13 +1,32 @@
 #include "isextract.h"
 #include "dostime.h"
+#include "stats.h"
+#include "threadpool.h"
 
+#include <sys/stat.h>
 #include <utime.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <sstream>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
 
 const uint32_t signature = 0x8C655D13;
 const int32_t data_start = 255;
 const uint32_t CHUNK = 16384;
+const uint64_t four_gib = uint64_t(1) << 32;
 /*const uint32_t YR_MASK  = 0xFE000000;
 const uint32_t MON_MASK = 0x01E00000;
 const uint32_t DAY_MASK = 0x001F0000;
@@ -15,189 +34,1098 @@ const uint32_t HR_MASK  = 0x0000F800;
 const uint32_t MIN_MASK = 0x000007E0;
 const uint32_t SEC_MASK = 0x0000001F;*/
 
+//input state for blast, each decode gets its own so they can run in parallel
+struct t_input {
+    const Source* source;
+    uint64_t pos;               //next offset to read
+    uint64_t end;               //end of the member's compressed data
+    unsigned char hold[CHUNK];
+};
+
 unsigned inf(void *how, unsigned char **buf)
 {
-    static unsigned char hold[CHUNK];
+    t_input* in = (t_input *)how;
+    uint64_t want = in->end - in->pos < CHUNK ? in->end - in->pos : CHUNK;
+    unsigned len;
+    STAT_SCOPE(STAT_T_READ);
 
-    *buf = hold;
-    return fread(hold, 1, CHUNK, (FILE *)how);
+    *buf = in->hold;
+    len = in->source->read(in->pos, in->hold, want);
+    in->pos += len;
+    STAT_ADD(STAT_BYTES_READ, len);
+    
+    return len;
 }
 
 int outf(void *how, unsigned char *buf, unsigned len)
 {
+    STAT_SCOPE(STAT_T_WRITE);
+    STAT_ADD(STAT_BYTES_WRITTEN, len);
+    
     return fwrite(buf, 1, len, (FILE *)how) != len;
 }
 
+int memf(void *how, unsigned char *buf, unsigned len)
+{
+    std::vector<unsigned char>* data = (std::vector<unsigned char> *)how;
+    
+    data->insert(data->end(), buf, buf + len);
+    
+    return 0;
+}
+
+int countf(void *how, unsigned char *buf, unsigned len)
+{
+    (void)buf;
+    *(uint64_t *)how += len;
+    
+    return 0;
+}
+
+//a file a member is written to, as is or gzip compressed on the way out
+struct t_sink {
+    FILE* fh;
+#ifdef HAVE_ZLIB
+    gzFile gz;
+#endif
+};
+
+//open path for writing, compressing at gzip level if it isn't 0
+bool openSink(t_sink& sink, const std::string& path, int gzip)
+{
+    sink.fh = NULL;
+    
+#ifdef HAVE_ZLIB
+    char mode[4] = {'w', 'b', char('0' + gzip), '\0'};
+    
+    sink.gz = NULL;
+    
+    if(gzip) {
+        if(!(sink.gz = gzopen(path.c_str(), mode))) return false;
+        
+        //fewer, larger writes, the default buffer is only 8K
+        gzbuffer(sink.gz, 128 * 1024);
+        return true;
+    }
+#else
+    if(gzip) return false;
+#endif
+    
+    return (sink.fh = fopen(path.c_str(), "wb")) != NULL;
+}
+
+int sinkf(void *how, unsigned char *buf, unsigned len)
+{
+#ifdef HAVE_ZLIB
+    t_sink* sink = (t_sink *)how;
+    
+    if(sink->gz) {
+        STAT_SCOPE(STAT_T_WRITE);
+        STAT_ADD(STAT_BYTES_WRITTEN, len);
+        
+        //gzwrite takes at most INT_MAX at a time, whole members can be more
+        while(len) {
+            unsigned part = len < (1U << 30) ? len : (1U << 30);
+            
+            if(gzwrite(sink->gz, buf, part) != int(part)) return 1;
+            
+            buf += part;
+            len -= part;
+        }
+        
+        return 0;
+    }
+#endif
+    
+    return outf(((t_sink *)how)->fh, buf, len);
+}
+
+//true if everything written made it to disk
+bool closeSink(t_sink& sink)
+{
+#ifdef HAVE_ZLIB
+    if(sink.gz) return gzclose(sink.gz) == Z_OK;
+#endif
+    
+    return fclose(sink.fh) == 0;
+}
+
+//state for comparing decoded output against a file already on disk, which
+//is read through zlib if it was written with gzip
+struct t_compare {
+    FILE* fh;
+#ifdef HAVE_ZLIB
+    gzFile gz;
+#endif
+    bool differs;
+};
+
+int cmpf(void *how, unsigned char *buf, unsigned len)
+{
+    //blast never hands us more than its 4k window at a time
+    unsigned char disk[4096];
+    t_compare* cmp = (t_compare *)how;
+    unsigned got;
+    
+#ifdef HAVE_ZLIB
+    if(cmp->gz) {
+        got = gzread(cmp->gz, disk, len) == int(len) ? len : 0;
+    } else {
+        got = fread(disk, 1, len, cmp->fh);
+    }
+#else
+    got = fread(disk, 1, len, cmp->fh);
+#endif
+    
+    if(got != len || memcmp(disk, buf, len) != 0) {
+        cmp->differs = true;
+        return 1;
+    }
+    
+    return 0;
+}
+
+//the length of what was extracted to path. A gzip file records it modulo
+//4GiB in its last 4 bytes, which is exact as members are never that big.
+uint64_t extractedSize(const std::string& path, const struct stat& st, int gzip)
+{
+    unsigned char isize[4];
+    FILE* fh;
+    bool good;
+    
+    if(!gzip) return st.st_size;
+    
+    if(!(fh = fopen(path.c_str(), "rb"))) return UINT64_MAX;
+    
+    good = fseek(fh, -4, SEEK_END) == 0 && fread(isize, 1, 4, fh) == 4;
+    fclose(fh);
+    
+    if(!good) return UINT64_MAX;
+    
+    return isize[0] | isize[1] << 8 | isize[2] << 16 | uint32_t(isize[3]) << 24;
+}
+
+//shared by every member of one extractAll, nested archives included.
+//Members are decoded into memory by group and written out by writers, the
+//memory budget holds decoders back when the writers fall behind.
+struct InstallShield::t_job {
+    const t_extract_options& options;
+    TaskGroup& group;
+    TaskGroup& writers;
+    Budget memory;
+    Budget files;
+    t_progress* progress;       //null if nobody is watching
+    std::atomic<bool> failed;
+    
+    t_job(const t_extract_options& opts, TaskGroup& tasks, TaskGroup& writes) :
+    options(opts),
+    group(tasks),
+    writers(writes),
+    memory(opts.memory),
+    files(opts.open_files),
+    progress(opts.progress),
+    failed(false)
+    {
+    }
+    
+    bool cancelled() const
+    {
+        return progress && progress->cancel.load(std::memory_order_relaxed);
+    }
+    
+    //a member has been written, skipped or given up on
+    void finished()
+    {
+        if(progress) progress->members_done.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+//wraps the output of an extraction that is being watched, counting what
+//passes through and stopping blast with an output error once cancelled.
+//Runs once per 4K block, blast's own loop is left alone.
+struct t_progress_out {
+    blast_out out;
+    void* how;
+    InstallShield::t_progress* progress;
+    bool writes;                //out writes to disk rather than memory
+};
+
+int progf(void *how, unsigned char *buf, unsigned len)
+{
+    t_progress_out* watched = (t_progress_out *)how;
+    
+    if(watched->progress->cancel.load(std::memory_order_relaxed)) return 1;
+    
+    watched->progress->bytes_decoded.fetch_add(len, std::memory_order_relaxed);
+    
+    if(watched->out(watched->how, buf, len)) return 1;
+    
+    if(watched->writes) watched->progress->bytes_written.fetch_add(len, std::memory_order_relaxed);
+    
+    return 0;
+}
+
 InstallShield::~InstallShield()
 {
     
 }
 
 InstallShield::InstallShield():
+m_dirs_loaded(0),
+m_toc_next(0),
+m_cache(NULL),
 m_dataoffset(data_start),
-m_datasize(0)
+m_datasize(0),
+m_datalimit(0)
+{
+    
+}
+
+void InstallShield::open(std::string& filename, uint64_t base, bool lazy)
 {
+    m_filename = std::string(filename);
     
+    open(std::make_shared<FileSource>(filename), base, lazy);
 }
 
-void InstallShield::open(std::string& filename)
+void InstallShield::open(const std::shared_ptr<Source>& source, uint64_t base, bool lazy)
 {
     uint32_t sig;
-    int32_t toc_address;
+    uint32_t archive_size;
+    uint32_t toc_address;
     uint16_t dir_count;
-    std::streampos pretoc;
-    m_filename = std::string(filename);
+    uint64_t toc;
+    std::ostringstream identity;
+    SourceReader in(*source, base);
+    STAT_SCOPE(STAT_T_OPEN);
     
-    m_fh.open(filename.c_str(), std::ios::binary|std::ios::in);
+    m_source = source;
     
-    if(!m_fh.is_open())
-        throw "Could not open file.";
+    //the same source can hold several archives at different offsets
+    identity << source->identity() << ':' << base;
+    m_identity = identity.str();
     
-    m_fh.read(reinterpret_cast<char*>(&sig), sizeof(uint32_t));
+    //archives embedded in something larger are addressed from their start
+    m_dataoffset = base + data_start;
+    in.read(&sig, sizeof(uint32_t));
     
     //test if we have what we think we have
     if(sig != signature)
         throw "Not a valid InstallShield 3 archive.";
     
     //get some basic info on where stuff is in file
-    m_fh.seekg(37, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&toc_address), sizeof(int32_t));
-    m_fh.seekg(4, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&dir_count), sizeof(uint16_t));
+    in.skip(14);
+    in.read(&archive_size, sizeof(uint32_t));
+    in.skip(19);
+    in.read(&toc_address, sizeof(uint32_t));
+    in.skip(4);
+    in.read(&dir_count, sizeof(uint16_t));
     
-    //find the toc and work out how many files we have in the archive
-    m_fh.seekg(toc_address, std::ios_base::beg);
+    if(!in.good() || toc_address < data_start || base + toc_address >= source->size())
+        throw "Not a valid InstallShield 3 archive.";
     
-    std::vector<uint32_t> dir_files;
+    //the header only has room for the low 32 bits of the toc address, past
+    //4GiB the toc is some multiple of 4GiB further on. It follows the data
+    //it describes so try the furthest first, parsing it in full to check it.
+    //The archive size is cut the same way, so unless there is another 4GiB
+    //past it the archive can't be that large. Writers that leave it zero
+    //only have the toc to go by.
+    toc = toc_address;
     
-    for(uint32_t i = 0; i < dir_count; i++) {
-        dir_files.push_back(parseDirs());
+    if(!archive_size || base + archive_size + four_gib <= source->size()) {
+        while(base + toc + four_gib < source->size()) {
+            toc += four_gib;
+        }
     }
+    
+    for(;;) {
+        try {
+            parseToc(toc, dir_count, lazy && toc < four_gib);
+    
+            //a wrapped toc has to account for all the data before it, one
+            //that happens to parse out of a larger file won't
+            if(toc >= four_gib && m_datasize != toc - data_start)
+                throw "Archive table of contents is corrupt.";
+    
+            return;
+        } catch (const char*) {
+            if(toc < four_gib) throw;
+            
+            toc -= four_gib;
+        }
+    }
+}
+
+void InstallShield::recover(std::string& filename, uint64_t base)
+{
+    m_filename = std::string(filename);
+    
+    recover(std::make_shared<FileSource>(filename), base);
+}
 
-    //parse the file entries in the toc to get filenames, size and location
-    for(uint32_t i = 0; i < dir_files.size(); i++){
-        for(uint32_t j = 0; j < dir_files[i]; j++) {
-            parseFiles();
+void InstallShield::recover(const std::shared_ptr<Source>& source, uint64_t base)
+{
+    uint32_t sig;
+    uint32_t archive_size;
+    uint32_t toc_address;
+    uint64_t end;
+    uint64_t pos;
+    uint32_t count = 0;
+    char name[16];
+    std::ostringstream identity;
+    SourceReader header(*source, base);
+    t_input in;
+    STAT_SCOPE(STAT_T_TOC);
+    
+    m_source = source;
+    
+    //a recovered index may not match what the toc would give, keep members
+    //cached from either apart
+    identity << source->identity() << ':' << base << ":recovered";
+    m_identity = identity.str();
+    
+    m_dataoffset = base + data_start;
+    header.read(&sig, sizeof(uint32_t));
+    header.skip(14);
+    header.read(&archive_size, sizeof(uint32_t));
+    header.skip(19);
+    header.read(&toc_address, sizeof(uint32_t));
+    
+    if(!header.good() || sig != signature)
+        throw "Not a valid InstallShield 3 archive.";
+    
+    //the data ends where the toc starts if the header still says where that
+    //is, otherwise it runs to the end of the file. As in open(), the toc is
+    //only looked for 4GiB further on if the archive size leaves room for it.
+    end = source->size();
+    
+    if(toc_address > data_start && base + toc_address < end) {
+        uint64_t toc = toc_address;
+        
+        while(base + toc + four_gib < end
+              && (!archive_size || base + archive_size + four_gib <= source->size())) {
+            toc += four_gib;
+        }
+        
+        end = base + toc;
+    }
+    
+    m_files.clear();
+    m_datasize = 0;
+    m_datalimit = end - m_dataoffset;
+    pos = m_dataoffset;
+    in.source = source.get();
+    in.end = end;
+    
+    //members are stored back to back, each stream ends on a byte boundary
+    //after its end code so the next one starts with the first byte blast
+    //didn't use. Where one fails to decode, look for the next byte that
+    //could start a stream.
+    while(pos + 2 < end) {
+        unsigned char head[2];
+        uint64_t size = 0;
+        unsigned left = 0;
+        unsigned char* next = NULL;
+        int rv;
+        
+        if(source->read(pos, head, 2) != 2)
+            throw "Failed to read archive data.";
+        
+        //literal flag of 0 or 1 and a 1K, 2K or 4K dictionary
+        if(head[0] > 1 || head[1] < 4 || head[1] > 6) {
+            pos++;
+            continue;
+        }
+        
+        in.pos = pos;
+        rv = blast(inf, &in, countf, &size, &left, &next);
+        
+        //a stream that runs off the end of the data can't be followed by
+        //another, trying each byte inside it would only decode to the end
+        //again
+        if(rv == 2) break;
+        
+        if(rv != 0 || size > UINT32_MAX) {
+            pos++;
+            continue;
         }
+        
+        snprintf(name, sizeof(name), "member%05u", ++count);
+        
+        t_entry& entry = m_files[name];
+        entry.offset = pos - m_dataoffset;
+        entry.compressed_size = in.pos - left - pos;
+        entry.uncompressed_size = size;
+        entry.datetime = 0x00210000;    //1980-01-01, the earliest dos time
+        
+        pos = in.pos - left;
+        m_datasize = pos - m_dataoffset;
     }
     
-    m_fh.close();
+    m_dir_files.assign(1, count);
+    m_dirs_loaded = 1;
+}
+
+//read the directory headers of the toc at toc_address and, unless lazy, all
+//the file entries that follow them
+void InstallShield::parseToc(uint64_t toc_address, uint16_t dir_count, bool lazy)
+{
+    SourceReader in(*m_source, m_dataoffset - data_start + toc_address);
+    
+    m_files.clear();
+    m_dir_files.clear();
+    m_dirs_loaded = 0;
+    m_datasize = 0;
+    
+    for(uint32_t i = 0; i < dir_count; i++) {
+        m_dir_files.push_back(parseDirs(in));
+    }
+    
+    if(!in.good())
+        throw "Archive table of contents is truncated.";
+    
+    //the file entries of all directories follow the directory headers
+    m_toc_next = in.tell();
+    m_datalimit = toc_address - data_start;
+    
+    if(lazy) return;
+    
+    while(m_dirs_loaded < m_dir_files.size()) {
+        parseDir();
+    }
+}
+
+//parse the file entries of the next directory into the index
+void InstallShield::parseDir() const
+{
+    SourceReader in(*m_source, m_toc_next);
+    uint32_t dir = m_dirs_loaded;
+    uint64_t datasize = m_datasize;
+    t_file_map files;
+    STAT_SCOPE(STAT_T_TOC);
+    
+    for(uint32_t i = 0; i < m_dir_files[dir]; i++) {
+        parseFiles(in, files, datasize);
+    }
+    
+    //the toc ran off the end of the file
+    if(!in.good())
+        throw "Archive table of contents is truncated.";
+    
+    m_files.insert(files.begin(), files.end());
+    m_datasize = datasize;
+    m_toc_next = in.tell();
+    m_dirs_loaded = dir + 1;
+}
+
+//load one more directory of a lazy open, call with m_toc_lock held. Returns
+//false once there are none left.
+bool InstallShield::loadDir() const
+{
+    if(m_dirs_loaded >= m_dir_files.size()) return false;
+    
+    try {
+        parseDir();
+    } catch (const char*) {
+        //nobody to report to from a lookup, keep the directories that parsed
+        m_dirs_loaded = m_dir_files.size();
+        return false;
+    }
+    
+    return true;
+}
+
+const InstallShield::t_file_map& InstallShield::files() const
+{
+    if(m_dirs_loaded < m_dir_files.size()) {
+        std::lock_guard<std::mutex> lock(m_toc_lock);
+        
+        while(loadDir()) {}
+    }
+    
+    return m_files;
 }
 
 void InstallShield::close()
 {
     m_filename = "";
+    m_identity = "";
+    m_source.reset();
 }
 
-uint32_t InstallShield::parseDirs()
+void InstallShield::setCache(MemberCache* cache)
+{
+    m_cache = cache;
+}
+
+uint32_t InstallShield::parseDirs(SourceReader& in)
 {
     uint16_t fcount;
     uint16_t chksize;
     uint16_t nlen;
     
-    m_fh.read(reinterpret_cast<char*>(&fcount), sizeof(uint16_t));
-    m_fh.read(reinterpret_cast<char*>(&chksize), sizeof(uint16_t));
-    m_fh.read(reinterpret_cast<char*>(&nlen), sizeof(uint16_t));
+    in.read(&fcount, sizeof(uint16_t));
+    in.read(&chksize, sizeof(uint16_t));
+    in.read(&nlen, sizeof(uint16_t));
     
-    std::cout << "We have " << fcount << " files\n";
+    if(chksize < nlen + 6)
+        throw "Archive table of contents is corrupt.";
     
     //skip the name of the dir, we just want the files
-    m_fh.seekg(nlen, std::ios_base::cur);
+    in.skip(nlen);
     
     //skip to end of chunk
-    m_fh.seekg(chksize - nlen - 6, std::ios_base::cur);
+    in.skip(chksize - nlen - 6);
 
     return fcount;
 }
 
 //uint AccumulatedData = 0;
-void InstallShield::parseFiles()
+void InstallShield::parseFiles(SourceReader& in, t_file_map& files, uint64_t& datasize) const
 {
     t_file_entry file;
     uint16_t chksize;
     uint8_t namelen;
     
-    m_fh.seekg(3, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&file.second.uncompressed_size), sizeof(uint32_t));
-    m_fh.read(reinterpret_cast<char*>(&file.second.compressed_size), sizeof(uint32_t));
-    m_fh.seekg(4, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&file.second.datetime) + 2, sizeof(uint16_t));
-    m_fh.read(reinterpret_cast<char*>(&file.second.datetime), sizeof(uint16_t));
-    m_fh.seekg(4, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&chksize), sizeof(uint16_t));
-    m_fh.seekg(4, std::ios_base::cur);
-    m_fh.read(reinterpret_cast<char*>(&namelen), sizeof(uint8_t));
+    in.skip(3);
+    in.read(&file.second.uncompressed_size, sizeof(uint32_t));
+    in.read(&file.second.compressed_size, sizeof(uint32_t));
+    in.skip(4);
+    in.read(reinterpret_cast<char*>(&file.second.datetime) + 2, sizeof(uint16_t));
+    in.read(&file.second.datetime, sizeof(uint16_t));
+    in.skip(4);
+    in.read(&chksize, sizeof(uint16_t));
+    in.skip(4);
+    in.read(&namelen, sizeof(uint8_t));
+    
+    if(chksize < namelen + 30)
+        throw "Archive table of contents is corrupt.";
     
     //read in file name, ensure null termination;
     uint8_t buffer[namelen + 1];
-    m_fh.read(reinterpret_cast<char*>(buffer), namelen);
+    in.read(buffer, namelen);
     buffer[namelen] = '\0';
     file.first = reinterpret_cast<char*>(buffer);
     
     //complete out file entry with the offset within the body.
-    file.second.offset = m_datasize;
+    file.second.offset = datasize;
+    
+    files.insert(file);
     
-    m_files.insert(file);
+    //increase body size to next offset for next file, 64 bits can't overflow
+    //on 65535 directories of 65535 files of at most 4GiB each
+    datasize += file.second.compressed_size;
     
-    //increase body size to next offset for next file
-    m_datasize += file.second.compressed_size;
+    //more data than there is room for between the header and the toc
+    if(datasize > m_datalimit)
+        throw "Archive table of contents is corrupt.";
     
     //skip to end of chunk
-    m_fh.seekg(chksize - namelen - 30, std::ios_base::cur);
+    in.skip(chksize - namelen - 30);
+}
+
+bool InstallShield::isCurrent(const std::string& filename, const t_entry& entry,
+                              const std::string& path, const t_extract_options& options) const
+{
+    struct stat st;
+    t_compare cmp;
+    int rv;
+    
+    if(options.mode == EXTRACT_ALL) return false;
+    
+    //cheap metadata check first, size and mtime are what we set on extract
+    if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    if(st.st_mtime != dos2unixtime(entry.datetime)) return false;
+    if(extractedSize(path, st, options.gzip) != entry.uncompressed_size) return false;
+    
+    if(options.mode == EXTRACT_CHANGED) return true;
+    
+    //decode the member and compare it against what is on disk, bailing out
+    //at the first differing block
+    cmp.fh = NULL;
+    cmp.differs = false;
+    
+#ifdef HAVE_ZLIB
+    cmp.gz = options.gzip ? gzopen(path.c_str(), "rb") : NULL;
+    
+    if(options.gzip && !cmp.gz) return false;
+#endif
+    
+    if(!options.gzip && !(cmp.fh = fopen(path.c_str(), "rb"))) return false;
+    
+    rv = decodeFile(filename, cmpf, &cmp);
+    
+#ifdef HAVE_ZLIB
+    if(cmp.gz) gzclose(cmp.gz);
+#endif
+    if(cmp.fh) fclose(cmp.fh);
+    
+    return rv == 0 && !cmp.differs;
+}
+
+bool InstallShield::extractFile(const std::string& filename, const std::string& dir,
+                                t_extract_mode mode) const
+{
+    t_extract_options options;
+    TaskGroup group(NULL);
+    TaskGroup writers(NULL);
+    
+    if(!findFile(filename)) return false;
+    
+    options.mode = mode;
+    
+    t_job job(options, group, writers);
+    extractMember(filename, dir, job);
+    
+    return !job.failed && !writers.failed();
+}
+
+void InstallShield::extractMember(const std::string& filename, const std::string& dir,
+                                  t_job& job) const
+{
+    const t_entry* entry = findFile(filename);
+    std::string path = dir + DIR_SEPARATOR + filename;
+    std::string target = job.options.gzip ? path + ".gz" : path;
+    std::shared_ptr<std::vector<unsigned char> > data;
+    
+    if(job.cancelled()) {
+        job.failed = true;
+        job.finished();
+        return;
+    }
+    
+    //nothing to do if the target is already up to date
+    if(isCurrent(filename, *entry, target, job.options)) {
+        STAT_ADD(STAT_MEMBERS_SKIPPED, 1);
+        
+        if(job.progress) job.progress->bytes_total.fetch_sub(entry->uncompressed_size);
+        
+        job.finished();
+        return;
+    }
+    
+    //holding this one in memory would blow the budget on its own
+    if(entry->uncompressed_size > job.memory.limit()) {
+        streamMember(filename, target, job);
+        return;
+    }
+    
+    {
+        STAT_SCOPE(STAT_T_THROTTLE);
+        job.memory.acquire(entry->uncompressed_size);
+    }
+    
+    //the budget only limits what is asked for, the allocations can still
+    //fail. Give back what was admitted so other decoders don't wait on it.
+    try {
+        data.reset(new std::vector<unsigned char>());
+        data->reserve(entry->uncompressed_size);
+    
+        if(decodeMember(filename, memf, data.get(), false, job) != 0) {
+            job.memory.release(entry->uncompressed_size);
+            job.failed = true;
+            job.finished();
+            return;
+        }
+    
+        //a nested archive hands its budget back early, as its members need it
+        if(job.options.recursive && extractNested(filename, path, data, job)) {
+            job.memory.release(entry->uncompressed_size);
+            job.finished();
+            return;
+        }
+    
+        job.writers.submit(std::bind(&InstallShield::writeMember, target, MemberCache::t_data(data),
+                                     entry->datetime, entry->uncompressed_size, std::ref(job)));
+    } catch (...) {
+        job.memory.release(entry->uncompressed_size);
+        job.failed = true;
+        job.finished();
+    }
+}
+
+//how far a cold extraction has got through the members in storage order
+//without gaps, so the data behind that can be dropped from the page cache
+struct InstallShield::t_cold {
+    std::mutex lock;
+    std::vector<bool> done;
+    size_t next;                //first member not yet done
+    
+    explicit t_cold(size_t members) : done(members, false), next(0) {}
+};
+
+//extract a member of a cold archive, having its compressed data and that
+//of the member stored after it fetched ahead of the decoder
+void InstallShield::extractCold(const std::vector<t_member_ref>& members, size_t index,
+                                t_cold& cold, const std::string& dir, t_job& job)
+{
+    const InstallShield* archive = members[index].first;
+    const t_entry* entry = archive->findFile(members[index].second);
+    size_t from;
+    
+    archive->m_source->advise(archive->dataOffset(*entry), entry->compressed_size,
+                              Source::ADVISE_WILLNEED);
+    
+    if(index + 1 < members.size()) {
+        const InstallShield* next = members[index + 1].first;
+        const t_entry* following = next->findFile(members[index + 1].second);
+        
+        next->m_source->advise(next->dataOffset(*following), following->compressed_size,
+                               Source::ADVISE_WILLNEED);
+    }
+    
+    archive->extractMember(members[index].second, dir, job);
+    
+    std::lock_guard<std::mutex> guard(cold.lock);
+    
+    cold.done[index] = true;
+    from = cold.next;
+    
+    while(cold.next < members.size() && cold.done[cold.next]) cold.next++;
+    
+    //drop everything from the start of an archive's data up to the last
+    //member done, not just the member itself. The page cache can hold data
+    //in blocks larger than a member that are only dropped whole, once all
+    //of one lies inside the range.
+    for(size_t i = from; i < cold.next; i++) {
+        if(i + 1 < cold.next && members[i + 1].first == members[i].first) continue;
+        
+        archive = members[i].first;
+        entry = archive->findFile(members[i].second);
+        archive->m_source->advise(archive->m_dataoffset,
+                                  archive->dataOffset(*entry) + entry->compressed_size
+                                  - archive->m_dataoffset, Source::ADVISE_DONTNEED);
+    }
 }
 
-bool InstallShield::extractFile(const std::string& filename, const std::string& dir)
+//decode straight to disk, for members too large to buffer. These are never
+//looked into for nested archives, which have to be opened from memory.
+void InstallShield::streamMember(const std::string& filename, const std::string& path,
+                                 t_job& job) const
 {
     //C style IO here because its easier to make work with Blast
-    t_file_entry file;
-    FILE* ifh;
-    FILE* ofh;
+    const t_entry* entry = findFile(filename);
     struct utimbuf tstamp;
+    t_sink sink;
+    int rv;
     
-    m_current_file = m_files.find(filename);
+    STAT_ADD(STAT_MEMBERS_STREAMED, 1);
     
-    if(m_current_file != m_files.end()) {
-        file = *m_current_file;
-    } else {
-        return false;
+    {
+        STAT_SCOPE(STAT_T_THROTTLE);
+        job.files.acquire(1);
+    }
+    
+    if(!openSink(sink, path, job.options.gzip)) {
+        job.files.release(1);
+        job.failed = true;
+        return;
+    }
+    
+    rv = decodeMember(filename, sinkf, &sink, true, job);
+    
+    if(!closeSink(sink) && rv == 0) rv = 1;
+    
+    job.files.release(1);
+    
+    if(rv != 0) job.failed = true;
+    
+    //don't leave half a file behind when asked to stop
+    if(rv != 0 && job.cancelled()) {
+        remove(path.c_str());
+        job.finished();
+        return;
+    }
+    
+    {
+        STAT_SCOPE(STAT_T_UTIME);
+        tstamp.actime = dos2unixtime(entry->datetime);
+        tstamp.modtime = tstamp.actime;
+        utime(path.c_str(), &tstamp);
     }
     
-    ifh = fopen(m_filename.c_str(), "rb");
-    ofh = fopen((dir + DIR_SEPARATOR + filename).c_str(), "wb");
+    job.finished();
+}
+
+//decodeFile for extraction, through progf when the job is being watched
+int InstallShield::decodeMember(const std::string& filename, blast_out out, void* how,
+                                bool writes, t_job& job) const
+{
+    t_progress_out watched;
+    
+    if(!job.progress) return decodeFile(filename, out, how);
+    
+    watched.out = out;
+    watched.how = how;
+    watched.progress = job.progress;
+    watched.writes = writes;
     
-    if(!ifh || !ofh) return false;
+    return decodeFile(filename, progf, &watched);
+}
+
+//if a decoded member is an archive itself, extract its members into a
+//directory at path on the same workers as everything else
+bool InstallShield::extractNested(const std::string& filename, const std::string& path,
+                                  const MemberCache::t_data& data, t_job& job) const
+{
+    std::shared_ptr<InstallShield> nested;
     
-    fseek(ifh, m_current_file->second.offset + m_dataoffset, SEEK_SET);
+    if(data->size() < 4 || ((*data)[0] | (*data)[1] << 8 | (*data)[2] << 16
+                            | uint32_t((*data)[3]) << 24) != signature) {
+        return false;
+    }
     
-    blast(inf, ifh, outf, ofh);
+    try {
+        nested = std::make_shared<InstallShield>();
+        nested->m_filename = m_filename;
+        nested->open(std::make_shared<MemorySource>(data, m_identity + DIR_SEPARATOR + filename));
+    } catch (const char*) {
+        //just happened to start with the signature, write it out as is
+        return false;
+    }
     
-    fclose(ifh);
-    fclose(ofh);
+    mkdir(path.c_str(), 0777);
     
-    tstamp.actime = dos2unixtime(m_current_file->second.datetime);
-    tstamp.modtime = tstamp.actime;
-    utime((dir + DIR_SEPARATOR + filename).c_str(), &tstamp);
+    for(t_file_iter it = nested->files().begin(); it != nested->files().end(); it++) {
+        if(job.progress) {
+            job.progress->members_total.fetch_add(1);
+            job.progress->bytes_total.fetch_add(it->second.uncompressed_size);
+        }
+        
+        job.group.submit(std::bind(&InstallShield::extractMember, nested,
+                                   it->first, path, std::ref(job)));
+    }
     
     return true;
 }
 
-bool InstallShield::extractAll(const std::string& dir)
+//write out a decoded member and give back the memory it was admitted with
+void InstallShield::writeMember(const std::string& path, const MemberCache::t_data& data,
+                                uint32_t datetime, uint32_t reserved, t_job& job)
 {
-    t_file_iter it = m_files.begin();
-    bool rv = true;
+    struct utimbuf tstamp;
+    t_sink sink;
+    bool opened = false;
+    bool good;
     
-    while(it != m_files.end()) {
-        if(!extractFile(it->first, dir)) rv = false;
+    if(!job.cancelled()) {
+        STAT_SCOPE(STAT_T_THROTTLE);
+        job.files.acquire(1);
         
-        it++;
+        if(!(opened = openSink(sink, path, job.options.gzip))) job.files.release(1);
+    }
+    
+    if(!opened) {
+        job.memory.release(reserved);
+        job.failed = true;
+        job.finished();
+        return;
+    }
+    
+    //compressing happens here on the writer threads, so members are
+    //compressed in parallel with each other and with decoding
+    good = data->empty() || !sinkf(&sink, const_cast<unsigned char*>(data->data()), data->size());
+    good = closeSink(sink) && good;
+    
+    if(!good) {
+        job.failed = true;
+    } else if(job.progress) {
+        job.progress->bytes_written.fetch_add(data->size(), std::memory_order_relaxed);
+    }
+    
+    job.files.release(1);
+    job.memory.release(reserved);
+    
+    {
+        STAT_SCOPE(STAT_T_UTIME);
+        tstamp.actime = dos2unixtime(datetime);
+        tstamp.modtime = tstamp.actime;
+        utime(path.c_str(), &tstamp);
+    }
+    
+    job.finished();
+}
+
+bool InstallShield::extractAll(const std::string& dir, t_extract_mode mode) const
+{
+    t_extract_options options;
+    
+    options.mode = mode;
+    
+    return extractAll(dir, options);
+}
+
+bool InstallShield::extractAll(const std::string& dir, const t_extract_options& options) const
+{
+    std::vector<t_member_ref> members;
+    
+    for(t_file_iter it = files().begin(); it != files().end(); it++) {
+        members.push_back(t_member_ref(this, it->first));
     }
     
+    return extractMembers(members, dir, options);
+}
+
+//orders members by archive and then where their data is stored
+struct t_storage_order {
+    bool operator()(const InstallShield::t_member_ref& a, const InstallShield::t_member_ref& b) const
+    {
+        if(a.first != b.first) return a.first < b.first;
+        
+        return a.first->findFile(a.second)->offset < b.first->findFile(b.second)->offset;
+    }
+};
+
+bool InstallShield::extractMembers(const std::vector<t_member_ref>& requested,
+                                   const std::string& dir, const t_extract_options& options)
+{
+    std::unique_ptr<ThreadPool> pool;
+    std::unique_ptr<ThreadPool> writer_pool;
+    std::vector<t_member_ref> members;
+    
+#ifndef HAVE_ZLIB
+    //built without zlib, there is nothing to compress with
+    if(options.gzip) return false;
+#endif
+    
+    //writers get their own threads, decoders waiting on the memory budget
+    //must not be able to starve the writes that would free it
+    if(options.threads != 1) {
+        pool.reset(new ThreadPool(options.threads));
+        writer_pool.reset(new ThreadPool(options.threads));
+    }
+    
+    TaskGroup group(pool.get());
+    TaskGroup writers(writer_pool.get());
+    t_job job(options, group, writers);
+    
+    //members that don't exist fail the job but leave the rest to extract
+    for(size_t i = 0; i < requested.size(); i++) {
+        if(requested[i].first->findFile(requested[i].second)) {
+            members.push_back(requested[i]);
+        } else {
+            job.failed = true;
+        }
+    }
+    
+    if(job.progress) {
+        uint64_t bytes = 0;
+        
+        for(size_t i = 0; i < members.size(); i++) {
+            bytes += members[i].first->findFile(members[i].second)->uncompressed_size;
+        }
+        
+        job.progress->members_total = members.size();
+        job.progress->members_done = 0;
+        job.progress->bytes_total = bytes;
+        job.progress->bytes_decoded = 0;
+        job.progress->bytes_written = 0;
+    }
+    
+    //cold archives are read front to back in storage order instead
+    if(options.cold) {
+        std::stable_sort(members.begin(), members.end(), t_storage_order());
+        
+        for(size_t i = 0; i < members.size(); i++) {
+            if(i == 0 || members[i].first != members[i - 1].first) {
+                members[i].first->m_source->advise(members[i].first->m_dataoffset, 0,
+                                                   Source::ADVISE_SEQUENTIAL);
+            }
+        }
+    }
+    
+    t_cold cold(members.size());
+    
+    for(size_t i = 0; i < members.size(); i++) {
+        if(options.cold) {
+            group.submit(std::bind(&InstallShield::extractCold, std::cref(members), i,
+                                   std::ref(cold), dir, std::ref(job)));
+        } else {
+            group.submit(std::bind(&InstallShield::extractMember, members[i].first,
+                                   members[i].second, dir, std::ref(job)));
+        }
+    }
+    
+    //every write is submitted by the time the decoders are done
+    group.wait();
+    writers.wait();
+    
+    return !job.failed && !group.failed() && !writers.failed();
+}
+
+uint64_t InstallShield::base() const
+{
+    return m_dataoffset - data_start;
+}
+
+const InstallShield::t_entry* InstallShield::findFile(const std::string& filename) const
+{
+    t_file_iter it;
+    
+    if(m_dirs_loaded < m_dir_files.size()) {
+        //parse directories in toc order until one holds the member
+        std::lock_guard<std::mutex> lock(m_toc_lock);
+        
+        while((it = m_files.find(filename)) == m_files.end() && loadDir()) {}
+    } else {
+        it = m_files.find(filename);
+    }
+    
+    return it == m_files.end() ? NULL : &it->second;
+}
+
+int InstallShield::decodeFile(const std::string& filename, blast_out out, void* how) const
+{
+    const t_entry* entry = findFile(filename);
+    t_input in;
+    int rv;
+    
+    if(!entry) return -10;
+    if(!m_source) return 3;
+    
+    in.source = m_source.get();
+    in.pos = entry->offset + m_dataoffset;
+    in.end = in.pos + entry->compressed_size;
+    
+    {
+        STAT_SCOPE(STAT_T_DECODE);
+        rv = blast(inf, &in, out, how, NULL, NULL);
+    }
+    
+    STAT_ADD(STAT_MEMBERS, 1);
+    
     return rv;
 }
 
+MemberCache::t_data InstallShield::readFile(const std::string& filename) const
+{
+    const t_entry* entry = findFile(filename);
+    std::shared_ptr<std::vector<unsigned char> > data;
+    MemberCache::t_data cached;
+    std::string key;
+    
+    if(!entry) return MemberCache::t_data();
+    
+    if(m_cache) {
+        key = MemberCache::key(m_identity, filename);
+        cached = m_cache->find(key);
+        
+        if(cached) return cached;
+    }
+    
+    data.reset(new std::vector<unsigned char>());
+    data->reserve(entry->uncompressed_size);
+    
+    if(decodeFile(filename, memf, data.get()) != 0) return MemberCache::t_data();
+    
+    if(m_cache) m_cache->insert(key, data);
+    
+    return data;
+}
+
 void InstallShield::listFiles()
 {
-    t_file_iter it = m_files.begin();
+    t_file_iter it = files().begin();
     std::string fname;
     uint32_t size;
     uint32_t csize;
@@ -9,9 +9,13 @@
 #define	ISEXTRACT_H
 
 #include "blast.h"
+#include "cache.h"
+#include "source.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <fstream>
 #include <map>
 
 #ifdef _WIN32
@@ -25,33 +29,136 @@
 class InstallShield
 {
 public:
-    InstallShield();
-    ~InstallShield();
-    void open(std::string& filename);
-    void close();
-    void listFiles();
-    bool extractFile(const std::string& filename, const std::string& dir);
-    bool extractAll(const std::string& dir);
-private:
+    //how extractFile treats a member that already exists at the target
+    enum t_extract_mode {
+        EXTRACT_ALL,        //always decode and rewrite
+        EXTRACT_CHANGED,    //skip if size and mtime already match the index
+        EXTRACT_VERIFY      //as EXTRACT_CHANGED, but also compare content
+    };
+    
+    //live counters of a running extractAll, safe to poll from any thread.
+    //Setting cancel stops it at the next 4K block of output.
+    struct t_progress {
+        std::atomic<uint32_t> members_total;    //nested archives add theirs
+        std::atomic<uint32_t> members_done;     //written, skipped or failed
+        std::atomic<uint64_t> bytes_total;      //uncompressed, less skipped
+        std::atomic<uint64_t> bytes_decoded;
+        std::atomic<uint64_t> bytes_written;
+        std::atomic<bool> cancel;
+        
+        t_progress() : members_total(0), members_done(0), bytes_total(0),
+                       bytes_decoded(0), bytes_written(0), cancel(false) {}
+    };
+    
+    struct t_extract_options {
+        t_extract_mode mode;
+        unsigned threads;   //worker threads, 0 for one per cpu, 1 for none
+        bool recursive;     //extract members that are archives into a
+                            //directory of their name instead of as files
+        uint64_t memory;    //decoded bytes waiting to be written at once,
+                            //bigger members are streamed straight to disk
+        unsigned open_files;//output files open at once, 0 for no limit
+        t_progress* progress;//counters to update, null for none
+        int gzip;           //1-9 to write each member gzip compressed at
+                            //that level as name.gz, needs ZLIB=1, 0 for none
+        bool cold;          //archives are read once, decode members in the
+                            //order they are stored, reading ahead, and keep
+                            //their compressed data out of the page cache
+        
+        t_extract_options() : mode(EXTRACT_ALL), threads(1), recursive(false),
+                              memory(64 << 20), open_files(64), progress(NULL),
+                              gzip(0), cold(false) {}
+    };
+    
     struct t_entry {
         uint32_t compressed_size;
         uint32_t uncompressed_size;
-        uint32_t offset;
+        uint64_t offset;        //from the start of the data, can pass 4GiB
         uint32_t datetime;
     };
     typedef std::map<std::string, t_entry> t_file_map;
+    
+    InstallShield();
+    ~InstallShield();
+    //open the archive starting base bytes into filename. A lazy open only
+    //reads the directory headers, file entries are parsed a directory at a
+    //time as lookups need them and a corrupt entry found then ends the index
+    void open(std::string& filename, uint64_t base = 0, bool lazy = false);
+    //open an archive from any source, such as a member decoded into memory
+    void open(const std::shared_ptr<Source>& source, uint64_t base = 0, bool lazy = false);
+    //open an archive whose table of contents is damaged or missing by
+    //decoding the data from the start to find where each member ends.
+    //Members are named member00001 and so on in the order they are stored.
+    void recover(std::string& filename, uint64_t base = 0);
+    void recover(const std::shared_ptr<Source>& source, uint64_t base = 0);
+    void close();
+    void listFiles();
+    bool extractFile(const std::string& filename, const std::string& dir,
+                     t_extract_mode mode = EXTRACT_ALL) const;
+    bool extractAll(const std::string& dir, t_extract_mode mode = EXTRACT_ALL) const;
+    bool extractAll(const std::string& dir, const t_extract_options& options) const;
+    //a member of some archive, to extract members of several at once
+    typedef std::pair<const InstallShield*, std::string> t_member_ref;
+    //extract members of any number of archives as one job sharing its
+    //threads, budgets and progress. Fails for members that don't exist.
+    static bool extractMembers(const std::vector<t_member_ref>& members,
+                               const std::string& dir, const t_extract_options& options);
+    //decode a member into memory, null if it is missing or fails to decode
+    MemberCache::t_data readFile(const std::string& filename) const;
+    //share decoded members through cache, which must outlive this object
+    void setCache(MemberCache* cache);
+    //identifies this version of the archive, for MemberCache::key
+    const std::string& identity() const { return m_identity; }
+    //index of all members by name, completes the index of a lazy open
+    const t_file_map& files() const;
+    //null if there is no such member
+    const t_entry* findFile(const std::string& filename) const;
+    //where the archive and a member's compressed data start within source(),
+    //for copying members without decoding them
+    const std::shared_ptr<Source>& source() const { return m_source; }
+    uint64_t base() const;
+    uint64_t dataOffset(const t_entry& entry) const { return m_dataoffset + entry.offset; }
+    //decode a member through a blast output function, returns blast's code
+    //or -10 if there is no such member and 3 if the archive can't be read
+    int decodeFile(const std::string& filename, blast_out out, void* how) const;
+private:
     typedef std::pair<std::string, t_entry> t_file_entry;
     typedef std::map<std::string, t_entry>::const_iterator t_file_iter;
+    struct t_job;
+    struct t_cold;
     
-    uint32_t parseDirs();
-    void parseFiles();
-    t_file_map m_files;
+    uint32_t parseDirs(SourceReader& in);
+    void parseToc(uint64_t toc_address, uint16_t dir_count, bool lazy);
+    void parseFiles(SourceReader& in, t_file_map& files, uint64_t& datasize) const;
+    void parseDir() const;
+    bool loadDir() const;
+    void extractMember(const std::string& filename, const std::string& dir, t_job& job) const;
+    static void extractCold(const std::vector<t_member_ref>& members, size_t index,
+                            t_cold& cold, const std::string& dir, t_job& job);
+    void streamMember(const std::string& filename, const std::string& path, t_job& job) const;
+    int decodeMember(const std::string& filename, blast_out out, void* how, bool writes,
+                     t_job& job) const;
+    bool extractNested(const std::string& filename, const std::string& path,
+                       const MemberCache::t_data& data, t_job& job) const;
+    static void writeMember(const std::string& path, const MemberCache::t_data& data,
+                            uint32_t datetime, uint32_t reserved, t_job& job);
+    bool isCurrent(const std::string& filename, const t_entry& entry,
+                   const std::string& path, const t_extract_options& options) const;
+    //lookups may fill in the index from any thread, m_toc_lock guards it
+    //until every directory is loaded, after which it no longer changes
+    mutable t_file_map m_files;
+    mutable std::mutex m_toc_lock;
+    mutable std::atomic<uint32_t> m_dirs_loaded;
+    mutable uint64_t m_toc_next;    //first file chunk not yet parsed
+    std::vector<uint32_t> m_dir_files;
     std::vector<std::string> m_filenames;
     std::string m_filename;
-    std::fstream m_fh;
-    uint32_t m_dataoffset;
-    uint32_t m_datasize;
-    t_file_iter m_current_file;
+    std::string m_identity;
+    MemberCache* m_cache;
+    std::shared_ptr<Source> m_source;
+    uint64_t m_dataoffset;
+    mutable uint64_t m_datasize;
+    uint64_t m_datalimit;           //room for data between header and toc
     int32_t m_file_remaining;
 };
 
@@ -0,0 +1,229 @@
+#include "libisextract.h"
+#include "isextract.h"
+#include <ctime>
+#include <cstring>
+#include <new>
+#include "dostime.h"
+
+struct isx_archive {
+    InstallShield archive;
+    std::vector<const InstallShield::t_file_map::value_type*> entries;
+    std::unique_ptr<MemberCache> cache;
+};
+
+//blast output into a caller supplied buffer
+struct t_buffer_out {
+    unsigned char* buf;
+    size_t len;
+    size_t used;
+};
+
+static int bufferf(void *how, unsigned char *buf, unsigned len)
+{
+    t_buffer_out* out = (t_buffer_out *)how;
+    
+    if(len > out->len - out->used) return 1;
+    
+    memcpy(out->buf + out->used, buf, len);
+    out->used += len;
+    
+    return 0;
+}
+
+//nothing may be thrown back into C, so anything that isn't a message, such as
+//std::bad_alloc or a std::system_error from starting threads, becomes a code.
+//Only to be called from a catch block.
+static int failure()
+{
+    try {
+        throw;
+    } catch (const std::bad_alloc&) {
+        return ISX_ERR_MEMORY;
+    } catch (...) {
+        return ISX_ERR_SYSTEM;
+    }
+}
+
+static const char* failureMessage()
+{
+    return failure() == ISX_ERR_MEMORY ? "Out of memory." : "Unexpected error.";
+}
+
+//throws as InstallShield::open does
+static isx_archive* openSource(const std::shared_ptr<Source>& source, uint64_t base)
+{
+    std::unique_ptr<isx_archive> handle(new isx_archive);
+    
+    handle->archive.open(source, base);
+    
+    for(InstallShield::t_file_map::const_iterator it = handle->archive.files().begin();
+        it != handle->archive.files().end(); it++) {
+        handle->entries.push_back(&*it);
+    }
+    
+    return handle.release();
+}
+
+static void fillEntry(const InstallShield::t_file_map::value_type& file, isx_entry* entry)
+{
+    entry->name = file.first.c_str();
+    entry->compressed_size = file.second.compressed_size;
+    entry->uncompressed_size = file.second.uncompressed_size;
+    entry->datetime = file.second.datetime;
+    entry->mtime = dos2unixtime(file.second.datetime);
+}
+
+isx_archive* isx_open(const char* path, uint64_t base, const char** error)
+{
+    try {
+        return openSource(std::make_shared<FileSource>(path), base);
+    } catch (const char* msg) {
+        if(error) *error = msg;
+    } catch (...) {
+        if(error) *error = failureMessage();
+    }
+    
+    return NULL;
+}
+
+isx_archive* isx_open_memory(const void* data, size_t len, const char** error)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    
+    try {
+        std::shared_ptr<std::vector<unsigned char> > copy(new std::vector<unsigned char>(bytes, bytes + len));
+    
+        //the copy lives as long as the archive, so its address is unique
+        std::string identity = "memory:" + std::to_string(reinterpret_cast<uintptr_t>(copy.get()));
+    
+        return openSource(std::make_shared<MemorySource>(copy, identity), 0);
+    } catch (const char* msg) {
+        if(error) *error = msg;
+    } catch (...) {
+        if(error) *error = failureMessage();
+    }
+    
+    return NULL;
+}
+
+void isx_close(isx_archive* archive)
+{
+    delete archive;
+}
+
+int isx_set_cache(isx_archive* archive, uint64_t budget)
+{
+    archive->archive.setCache(NULL);
+    
+    try {
+        archive->cache.reset(budget ? new MemberCache(budget) : NULL);
+    } catch (...) {
+        //left without a cache
+        archive->cache.reset();
+    
+        return failure();
+    }
+    
+    archive->archive.setCache(archive->cache.get());
+    
+    return ISX_OK;
+}
+
+size_t isx_count(const isx_archive* archive)
+{
+    return archive->entries.size();
+}
+
+int isx_entry_at(const isx_archive* archive, size_t index, isx_entry* entry)
+{
+    if(index >= archive->entries.size()) return ISX_ERR_NOENT;
+    
+    fillEntry(*archive->entries[index], entry);
+    
+    return ISX_OK;
+}
+
+int isx_find(const isx_archive* archive, const char* name, isx_entry* entry)
+{
+    InstallShield::t_file_map::const_iterator it;
+    
+    try {
+        it = archive->archive.files().find(name);
+    } catch (...) {
+        return failure();
+    }
+    
+    if(it == archive->archive.files().end()) return ISX_ERR_NOENT;
+    
+    fillEntry(*it, entry);
+    
+    return ISX_OK;
+}
+
+//isx_read without the catch
+static int readMember(const isx_archive* archive, const char* name, void* buf, size_t len,
+                      size_t* written)
+{
+    const InstallShield::t_entry* entry = archive->archive.findFile(name);
+    t_buffer_out out;
+    
+    if(written) *written = 0;
+    
+    if(!entry) return ISX_ERR_NOENT;
+    if(len < entry->uncompressed_size) return ISX_ERR_SPACE;
+    
+    //with a cache, hot members are copied out of memory instead of decoded
+    if(archive->cache) {
+        MemberCache::t_data data = archive->archive.readFile(name);
+        
+        if(!data) return ISX_ERR_DECODE;
+        if(data->size() > len) return ISX_ERR_SPACE;
+        
+        if(!data->empty()) memcpy(buf, data->data(), data->size());
+        if(written) *written = data->size();
+        
+        return ISX_OK;
+    }
+    
+    out.buf = static_cast<unsigned char*>(buf);
+    out.len = len;
+    out.used = 0;
+    
+    switch(archive->archive.decodeFile(name, bufferf, &out)) {
+    case 0:
+        break;
+    case 1:
+        return ISX_ERR_SPACE;
+    case 3:
+        return ISX_ERR_OPEN;
+    default:
+        return ISX_ERR_DECODE;
+    }
+    
+    if(written) *written = out.used;
+    
+    return ISX_OK;
+}
+
+int isx_read(const isx_archive* archive, const char* name, void* buf, size_t len,
+             size_t* written)
+{
+    try {
+        return readMember(archive, name, buf, len, written);
+    } catch (...) {
+        return failure();
+    }
+}
+
+int isx_extract(const isx_archive* archive, const char* dir, unsigned threads)
+{
+    InstallShield::t_extract_options options;
+    
+    options.threads = threads;
+    
+    try {
+        return archive->archive.extractAll(dir, options) ? ISX_OK : ISX_ERR_EXTRACT;
+    } catch (...) {
+        return failure();
+    }
+}
@@ -0,0 +1,83 @@
+/* 
+ * File:   libisextract.h
+ * 
+ * C interface to libisextract, for embedding the extractor in other
+ * programs and for foreign function interfaces. All functions may be called
+ * from any thread, an archive can be shared between threads once open.
+ */
+
+#ifndef LIBISEXTRACT_H
+#define	LIBISEXTRACT_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+/* the library is built with hidden visibility, only these are exported */
+#if defined(__GNUC__) && !defined(_WIN32)
+#define ISX_API __attribute__((visibility("default")))
+#else
+#define ISX_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct isx_archive isx_archive;
+
+typedef struct isx_entry {
+    const char* name;           /* valid until the archive is closed */
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t datetime;          /* dos date and time */
+    int64_t mtime;              /* datetime as a unix time */
+} isx_entry;
+
+/* return codes */
+#define ISX_OK           0
+#define ISX_ERR_OPEN    -1      /* file could not be opened or read */
+#define ISX_ERR_FORMAT  -2      /* not a valid archive */
+#define ISX_ERR_NOENT   -3      /* no such member */
+#define ISX_ERR_SPACE   -4      /* buffer smaller than the member */
+#define ISX_ERR_DECODE  -5      /* member data is corrupt */
+#define ISX_ERR_EXTRACT -6      /* some members could not be extracted */
+#define ISX_ERR_MEMORY  -7      /* out of memory */
+#define ISX_ERR_SYSTEM  -8      /* any other failure, such as threads that
+                                   could not be started */
+
+/* Open the archive starting base bytes into the file at path. Returns NULL
+ * on failure, and if error is not NULL points it at a static message. */
+ISX_API isx_archive* isx_open(const char* path, uint64_t base, const char** error);
+
+/* Open an archive held in memory, data is copied. */
+ISX_API isx_archive* isx_open_memory(const void* data, size_t len, const char** error);
+
+ISX_API void isx_close(isx_archive* archive);
+
+/* Keep up to budget bytes of decoded members in memory for isx_read, 0 turns
+ * the cache off. Not safe while other threads use the archive. */
+ISX_API int isx_set_cache(isx_archive* archive, uint64_t budget);
+
+/* Members are numbered 0 to isx_count() - 1 in name order. */
+ISX_API size_t isx_count(const isx_archive* archive);
+ISX_API int isx_entry_at(const isx_archive* archive, size_t index, isx_entry* entry);
+ISX_API int isx_find(const isx_archive* archive, const char* name, isx_entry* entry);
+
+/* Decode member name into buf, which must hold its uncompressed_size bytes.
+ * The number of bytes decoded is stored in written if it is not NULL. */
+ISX_API int isx_read(const isx_archive* archive, const char* name, void* buf, size_t len,
+                     size_t* written);
+
+/* Extract every member to dir using threads workers, 0 for one per cpu. */
+ISX_API int isx_extract(const isx_archive* archive, const char* dir, unsigned threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* LIBISEXTRACT_H */
@@ -1,10 +1,299 @@
 #include "isextract.h"
+#include "archiveset.h"
+#include "diff.h"
+#include "fusefs.h"
+#include "manifest.h"
+#include "scan.h"
+#include "server.h"
+#include "stats.h"
+#include "writer.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+//extraction in progress, for the SIGINT handler to cancel
+static InstallShield::t_progress* running = NULL;
+
+static void cancelExtract(int)
+{
+    if(running) running->cancel = true;
+    
+    //a second interrupt kills us outright
+    signal(SIGINT, SIG_DFL);
+}
+
+//keep a status line on stderr up to date until done is set
+static void reportProgress(const InstallShield::t_progress* progress, const std::atomic<bool>* done)
+{
+    for(unsigned tick = 0; !*done; tick++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        
+        if(tick % 5 && !*done) continue;
+        
+        std::cerr << "\r" << progress->members_done << "/" << progress->members_total
+                  << " files, " << (progress->bytes_decoded >> 20) << "/"
+                  << (progress->bytes_total >> 20) << " MB" << std::flush;
+    }
+    
+    std::cerr << "\n";
+}
 
 void printUse()
 {
-    std::cout << "Useage is \"isextract [mode] [file] (dir)\"\n"
-              << "mode options are \'x\' for extract and \'l\' for list.\n";
+    std::cout << "Useage is \"isextract [options] [mode] [file] (dir)\"\n"
+              << "mode options are \'x\' for extract, \'u\' for update and \'l\' for list.\n"
+              << "\'p\' writes the member named in place of dir to stdout.\n"
+              << "\'f\' mounts the archive read only at dir, if built with FUSE=1.\n"
+              << "\'s\' scans file for embedded archives and lists their offsets.\n"
+              << "\'c\' copies the members into new archives named dir1.z, dir2.z...\n"
+              << "holding up to the number of MB given after dir of compressed data each.\n"
+              << "update only extracts files whose size or time differ on disk.\n"
+              << "\"isextract h [file]...\" prints each member's sizes, time and XXH64 hash.\n"
+              << "\"isextract v [old] [new]\" lists members removed (-), added (+), changed (M)\n"
+              << "or only redated (T) between two archives, comparing compressed data.\n"
+              << "\"isextract m [out] [file]...\" merges archives into out, members of later\n"
+              << "archives replace those of the same name in earlier ones.\n"
+              << "\"isextract d [socket] [file]...\" serves the archives on a unix socket.\n"
+              << "\"isextract q [socket] [a|l|s|r] (archive) (member)\" queries a server,\n"
+              << "a lists archives, l members of archive, s stats and r reads a member.\n"
+              << "options:\n"
+              << "  --verify      with \'u\', also compare the content of unchanged files.\n"
+              << "  --stats       print timings and counters to stderr when done.\n"
+              << "  --stats=json  as --stats, but as a json object.\n"
+              << "  --threads=N   worker threads, defaults to one per cpu.\n"
+              << "  --cache=MB    decoded member cache size for \'d\' and \'f\', default 64.\n"
+              << "  --foreground  with \'f\', stay in the foreground until unmounted.\n"
+              << "  --offset=N    open an archive embedded N bytes into file.\n"
+              << "  --recursive   with \'x\' and \'u\', extract archives found inside the\n"
+              << "                archive into a directory named after them.\n"
+              << "  --memory=MB   decoded data waiting to be written when extracting,\n"
+              << "                larger members are streamed to disk, default 64.\n"
+              << "  --open-files=N  files written at once when extracting, default 64.\n"
+              << "  --progress    with \'x\' and \'u\', show progress on stderr.\n"
+              << "  --gzip[=N]    with \'x\' and \'u\', write each file gzip compressed at\n"
+              << "                level N, default 6, as name.gz, if built with ZLIB=1.\n"
+              << "  --cold        with \'x\' and \'u\', decode in storage order reading ahead\n"
+              << "                and keep the archive out of the page cache.\n"
+              << "  --content     with \'v\', decode members whose compressed data differs\n"
+              << "                and list those with the same content as repacked (R).\n"
+              << "  --recover     ignore the table of contents and find the members by\n"
+              << "                decoding the data, naming them member00001 and on.\n";
+}
+
+int serveArchives(const std::vector<std::string>& args, unsigned threads, uint64_t cache,
+                  bool recover)
+{
+    AssetServer server(threads, cache);
+    
+    for(uint32_t i = 2; i < args.size(); i++) {
+        std::string filepath = args[i];
+        
+        try {
+            server.addArchive(filepath, recover);
+        } catch (const char* msg) {
+            std::cout << "Error: " << filepath << ": " << msg << "\n";
+            return -1;
+        }
+    }
+    
+    if(!server.serve(args[1])) {
+        std::cout << "Error: Could not listen on " << args[1] << "\n";
+        return -1;
+    }
+    
+    return 0;
+}
+
+int scan(const std::string& filepath)
+{
+    std::vector<t_found_archive> found;
+    
+    try {
+        found = findArchives(filepath);
+    } catch (const char* msg) {
+        std::cout << "Error: " << msg << "\n";
+        return -1;
+    }
+    
+    std::cout << "Found " << found.size() << " archives: \n";
+    
+    for(uint32_t i = 0; i < found.size(); i++) {
+        std::cout << "offset " << found[i].offset << " " << found[i].files << " files\n";
+    }
+    
+    return 0;
+}
+
+int merge(const std::vector<std::string>& args, bool recover)
+{
+    ArchiveSet archives;
+    std::vector<std::string> names;
+    
+    try {
+        for(uint32_t i = 2; i < args.size(); i++) {
+            archives.add(args[i], recover);
+        }
+        
+        ArchiveWriter out(args[1]);
+        
+        for(ArchiveSet::t_name_index::const_iterator it = archives.members().begin();
+            it != archives.members().end(); it++) {
+            names.push_back(it->first);
+        }
+        
+        //written in name order, as an archive would list them
+        std::sort(names.begin(), names.end());
+        
+        for(uint32_t i = 0; i < names.size(); i++) {
+            if(!out.addMember(*archives.find(names[i])->archive, names[i])) {
+                std::cout << "Error: Could not copy " << names[i] << "\n";
+                return -1;
+            }
+        }
+        
+        out.finish();
+        std::cout << "Wrote " << out.members() << " files to " << args[1] << "\n";
+    } catch (const char* msg) {
+        std::cout << "Error: " << msg << "\n";
+        return -1;
+    }
+    
+    return 0;
+}
+
+int split(const InstallShield& infile, const std::string& prefix, uint64_t limit)
+{
+    std::unique_ptr<ArchiveWriter> out;
+    std::string filepath;
+    unsigned parts = 0;
+    
+    try {
+        for(InstallShield::t_file_map::const_iterator it = infile.files().begin();
+            it != infile.files().end(); it++) {
+            //start the next part unless this member alone is over the limit
+            if(out && out->members() && out->dataSize() + it->second.compressed_size > limit) {
+                out->finish();
+                std::cout << "Wrote " << out->members() << " files to " << filepath << "\n";
+                out.reset();
+            }
+            
+            if(!out) {
+                std::ostringstream name;
+                
+                name << prefix << ++parts << ".z";
+                filepath = name.str();
+                out.reset(new ArchiveWriter(filepath));
+            }
+            
+            if(!out->addMember(infile, it->first)) {
+                std::cout << "Error: Could not copy " << it->first << "\n";
+                return -1;
+            }
+        }
+        
+        if(out) {
+            out->finish();
+            std::cout << "Wrote " << out->members() << " files to " << filepath << "\n";
+        }
+    } catch (const char* msg) {
+        std::cout << "Error: " << msg << "\n";
+        return -1;
+    }
+    
+    return 0;
+}
+
+int diff(const std::vector<std::string>& args, bool content, unsigned threads, bool recover)
+{
+    static const char kinds[] = {'-', '+', 'M', 'R', 'T'};
+    InstallShield from;
+    InstallShield to;
+    std::vector<t_member_diff> diffs;
+    
+    try {
+        std::string from_path = args[1];
+        std::string to_path = args[2];
+        
+        if(recover) {
+            from.recover(from_path);
+            to.recover(to_path);
+        } else {
+            from.open(from_path);
+            to.open(to_path);
+        }
+    } catch (const char* msg) {
+        std::cout << "Error: " << msg << "\n";
+        return -1;
+    }
+    
+    diffs = diffArchives(from, to, content, threads);
+    
+    for(uint32_t i = 0; i < diffs.size(); i++) {
+        std::cout << kinds[diffs[i].kind] << ' ' << diffs[i].name << "\n";
+    }
+    
+    //like diff, 1 if there were differences
+    return diffs.empty() ? 0 : 1;
+}
+
+int manifest(const std::vector<std::string>& args, unsigned threads, bool recover)
+{
+    std::vector<std::string> archives(args.begin() + 1, args.end());
+    
+    try {
+        if(!writeManifest(archives, threads, std::cout, recover)) {
+            std::cerr << "Error: Some members could not be decoded.\n";
+            return -1;
+        }
+    } catch (const char* msg) {
+        std::cerr << "Error: " << msg << "\n";
+        return -1;
+    }
+    
+    return 0;
+}
+
+int query(const std::vector<std::string>& args)
+{
+    static const char* const status[] = {
+        "ok", "no such archive", "no such member", "decode error", "bad request"
+    };
+    char op = args.size() >= 3 && args[2].size() == 1 ? args[2][0] : 0;
+    uint16_t archive = args.size() >= 4 ? atoi(args[3].c_str()) : 0;
+    std::string member = args.size() >= 5 ? args[4] : "";
+    int rv;
+    
+    if(op != 'a' && op != 'l' && op != 's' && op != 'r') {
+        printUse();
+        return 0;
+    }
+    
+    rv = queryServer(args[1], op - 'a' + 'A', archive, member, stdout);
+    
+    if(rv < 0) {
+        std::cerr << "Error: Could not query server at " << args[1] << "\n";
+        return -1;
+    }
+    
+    if(rv != SERVER_OK) {
+        std::cerr << "Error: " << (rv <= SERVER_BAD_REQUEST ? status[rv] : "unknown") << "\n";
+        return -1;
+    }
+    
+    return 0;
+}
+
+//print the run's statistics to stderr if they were asked for, passing the
+//mode's return value through
+int reportStats(int rv, bool stats, bool json)
+{
+    if(stats) statsReport(std::cerr, json);
+    
+    return rv;
 }
 
 int main(int argc, char** argv)
@@ -12,34 +301,192 @@ int main(int argc, char** argv)
     std::string mode;
     std::string filepath;
     std::string outdir = "./";
+    std::vector<std::string> args;
+    bool verify = false;
+    bool stats = false;
+    bool stats_json = false;
+    bool foreground = false;
+    bool recursive = false;
+    bool progress = false;
+    bool recover = false;
+    bool content = false;
+    bool cold = false;
+    unsigned threads = 0;
+    uint64_t cache = 64;
+    uint64_t memory = 64;
+    unsigned open_files = 64;
+    int gzip = 0;
+    uint64_t offset = 0;
     InstallShield infile;
     
-    if(argc < 3) {
+    //split out options, everything else is positional
+    for(int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+    
+        if(arg == "--verify") {
+            verify = true;
+        } else if(arg == "--stats") {
+            stats = true;
+        } else if(arg == "--stats=json") {
+            stats = true;
+            stats_json = true;
+        } else if(arg == "--recursive") {
+            recursive = true;
+        } else if(arg == "--progress") {
+            progress = true;
+        } else if(arg == "--cold") {
+            cold = true;
+        } else if(arg == "--content") {
+            content = true;
+        } else if(arg == "--recover") {
+            recover = true;
+        } else if(arg == "--gzip") {
+            gzip = 6;
+        } else if(arg.compare(0, 7, "--gzip=") == 0) {
+            gzip = atoi(arg.c_str() + 7);
+            
+            if(gzip < 1 || gzip > 9) {
+                printUse();
+                return 0;
+            }
+        } else if(arg == "--foreground") {
+            foreground = true;
+        } else if(arg.compare(0, 10, "--threads=") == 0) {
+            threads = atoi(arg.c_str() + 10);
+        } else if(arg.compare(0, 8, "--cache=") == 0) {
+            cache = strtoull(arg.c_str() + 8, NULL, 10);
+        } else if(arg.compare(0, 9, "--memory=") == 0) {
+            memory = strtoull(arg.c_str() + 9, NULL, 10);
+        } else if(arg.compare(0, 13, "--open-files=") == 0) {
+            open_files = atoi(arg.c_str() + 13);
+        } else if(arg.compare(0, 9, "--offset=") == 0) {
+            offset = strtoull(arg.c_str() + 9, NULL, 0);
+        } else if(arg.compare(0, 2, "--") == 0) {
+            printUse();
+            return 0;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    
+    if(args.size() < 2) {
         printUse();
         return 0;
     }
     
-    mode = argv[1];
-    filepath = argv[2];
+    mode = args[0];
+    filepath = args[1];
+    
+    if(mode == "d") {
+        return reportStats(serveArchives(args, threads, cache << 20, recover), stats, stats_json);
+    } else if(mode == "q") {
+        return reportStats(query(args), stats, stats_json);
+    } else if(mode == "s") {
+        return reportStats(scan(filepath), stats, stats_json);
+    } else if(mode == "m") {
+        return reportStats(merge(args, recover), stats, stats_json);
+    } else if(mode == "v" && args.size() >= 3) {
+        return reportStats(diff(args, content, threads, recover), stats, stats_json);
+    } else if(mode == "h") {
+        return reportStats(manifest(args, threads, recover), stats, stats_json);
+    }
     
-    if(argc >= 4) {
-        outdir = argv[3];
+    if(args.size() >= 3) {
+        outdir = args[2];
     }
     
     try {
-        infile.open(filepath);
+        //a single member only needs the directories up to the one holding it
+        if(recover) {
+            infile.recover(filepath, offset);
+        } else {
+            infile.open(filepath, offset, mode == "p");
+        }
     } catch (const char* msg) {
         std::cout << "Error: " << msg << "\n";
         return -1;
     }
     
-    if(mode == "x"){
-        infile.extractAll(outdir);
+    if(mode == "x" || mode == "u"){
+        InstallShield::t_extract_options options;
+        
+        if(mode == "u") {
+            options.mode = verify ? InstallShield::EXTRACT_VERIFY
+                                  : InstallShield::EXTRACT_CHANGED;
+        }
+        
+        options.threads = threads;
+        options.recursive = recursive;
+        options.memory = memory << 20;
+        options.open_files = open_files;
+        options.gzip = gzip;
+        options.cold = cold;
+        
+#ifndef HAVE_ZLIB
+        if(gzip) {
+            std::cout << "Error: Built without zlib support, rebuild with ZLIB=1.\n";
+            return -1;
+        }
+#endif
+        
+        //always watched, so an interrupt stops at a clean point
+        InstallShield::t_progress status;
+        std::atomic<bool> done(false);
+        std::thread reporter;
+        bool extracted;
+        
+        options.progress = &status;
+        running = &status;
+        signal(SIGINT, cancelExtract);
+        
+        if(progress) reporter = std::thread(reportProgress, &status, &done);
+        
+        extracted = infile.extractAll(outdir, options);
+        
+        done = true;
+        
+        if(reporter.joinable()) reporter.join();
+        
+        signal(SIGINT, SIG_DFL);
+        running = NULL;
+        
+        if(status.cancel) {
+            std::cout << "Error: Extraction cancelled.\n";
+            return -1;
+        }
+        
+        //members that failed to decode or write, the rest are extracted
+        if(!extracted) {
+            std::cout << "Error: Some files could not be extracted.\n";
+            return -1;
+        }
     } else if(mode == "l") {
         infile.listFiles();
+    } else if(mode == "f" && args.size() >= 3) {
+        MemberCache members(cache << 20);
+        int rv = mountArchive(infile, args[2], members, threads, foreground);
+        
+        if(rv == -1) {
+            std::cout << "Error: Built without FUSE support, rebuild with FUSE=1.\n";
+            return -1;
+        } else if(rv != 0) {
+            std::cout << "Error: Could not mount at " << args[2] << "\n";
+            return -1;
+        }
+    } else if(mode == "c" && args.size() >= 4) {
+        return split(infile, args[2], strtoull(args[3].c_str(), NULL, 10) << 20);
+    } else if(mode == "p" && args.size() >= 3) {
+        MemberCache::t_data data = infile.readFile(args[2]);
+        
+        if(!data) {
+            std::cerr << "Error: Could not read " << args[2] << "\n";
+            return -1;
+        }
+        
+        fwrite(data->data(), 1, data->size(), stdout);
     } else {
         printUse();
     }
     
-    return 0;
-}
\ No newline at end of file
+    return reportStats(0, stats, stats_json);
+}
@@ -0,0 +1,90 @@
+#include "manifest.h"
+#include "isextract.h"
+#include "threadpool.h"
+#include "xxhash.h"
+
+#include <iomanip>
+#include <memory>
+
+//a member to hash and, once its task has run, the result
+struct t_hash_job {
+    const InstallShield* archive;
+    std::string name;
+    uint64_t hash;
+    bool ok;
+};
+
+static void hashMember(t_hash_job* job)
+{
+    XXH64 hash;
+    
+    job->ok = job->archive->decodeFile(job->name, XXH64::sink, &hash) == 0;
+    job->hash = hash.digest();
+}
+
+bool writeManifest(const std::vector<std::string>& archives, unsigned threads,
+                   std::ostream& out, bool recover)
+{
+    std::vector<std::unique_ptr<InstallShield> > opened;
+    std::vector<t_hash_job> jobs;
+    std::unique_ptr<ThreadPool> pool;
+    bool ok = true;
+    
+    for(size_t i = 0; i < archives.size(); i++) {
+        std::string filepath = archives[i];
+        
+        opened.push_back(std::unique_ptr<InstallShield>(new InstallShield()));
+        
+        if(recover) {
+            opened.back()->recover(filepath);
+        } else {
+            opened.back()->open(filepath);
+        }
+        
+        for(InstallShield::t_file_map::const_iterator it = opened.back()->files().begin();
+            it != opened.back()->files().end(); it++) {
+            t_hash_job job;
+            
+            job.archive = opened.back().get();
+            job.name = it->first;
+            job.hash = 0;
+            job.ok = false;
+            jobs.push_back(job);
+        }
+    }
+    
+    if(threads != 1) pool.reset(new ThreadPool(threads));
+    
+    //jobs no longer grows, so tasks can hold pointers into it
+    {
+        TaskGroup group(pool.get());
+        
+        for(size_t i = 0; i < jobs.size(); i++) {
+            group.submit(std::bind(hashMember, &jobs[i]));
+        }
+        
+        group.wait();
+    }
+    
+    //print in archive and name order whatever order they finished in
+    for(size_t i = 0, archive = 0; i < jobs.size(); i++) {
+        const InstallShield::t_entry* entry = jobs[i].archive->findFile(jobs[i].name);
+        
+        while(opened[archive].get() != jobs[i].archive) archive++;
+        
+        out << archives[archive] << '\t' << jobs[i].name << '\t'
+            << entry->uncompressed_size << '\t' << entry->compressed_size << '\t'
+            << std::hex << std::setfill('0') << std::setw(8) << entry->datetime << '\t';
+        
+        if(jobs[i].ok) {
+            out << std::setw(16) << jobs[i].hash;
+        } else {
+            out << "error";
+            ok = false;
+        }
+        
+        out << std::dec << std::setfill(' ') << '\n';
+    }
+    
+    return ok;
+}
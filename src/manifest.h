@@ -0,0 +1,24 @@
+/* 
+ * File:   manifest.h
+ * 
+ * Content hashes of every member of a set of archives, decoded in parallel
+ * straight into the hash without touching the filesystem.
+ */
+
+#ifndef MANIFEST_H
+#define	MANIFEST_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+//write a line per member of each archive to out, tab separated: archive,
+//member name, uncompressed size, compressed size, dos datetime in hex and the
+//XXH64 of the decoded content in hex, or "error" if it failed to decode.
+//Members are hashed on threads workers, 0 for one per cpu. With recover the
+//archives are opened with InstallShield::recover. Throws if an archive can't
+//be opened, returns false if any member failed.
+bool writeManifest(const std::vector<std::string>& archives, unsigned threads,
+                   std::ostream& out, bool recover = false);
+
+#endif	/* MANIFEST_H */
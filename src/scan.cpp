@@ -0,0 +1,113 @@
+#include "scan.h"
+#include "isextract.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//the archive signature 0x8C655D13 as it appears on disk
+static const unsigned char sig_bytes[4] = {0x13, 0x5D, 0x65, 0x8C};
+const uint32_t SCAN_CHUNK = 4 << 20;
+
+static void findScalar(const unsigned char* buf, size_t len, uint64_t base,
+                       std::vector<uint64_t>& found)
+{
+    const unsigned char* p = buf;
+    const unsigned char* end = buf + len;
+    
+    //memchr for the first byte is already vectorised by most libcs
+    while(end - p >= 4) {
+        p = static_cast<const unsigned char*>(memchr(p, sig_bytes[0], end - p - 3));
+        
+        if(!p) break;
+        
+        if(memcmp(p, sig_bytes, 4) == 0) found.push_back(base + (p - buf));
+        
+        p++;
+    }
+}
+
+void findSignatures(const unsigned char* buf, size_t len, uint64_t base,
+                    std::vector<uint64_t>& found)
+{
+    size_t i = 0;
+    
+#ifdef __SSE2__
+    //compare 16 candidate positions at once, one byte of the signature per
+    //shifted load, a set bit in the combined mask is a full match
+    const __m128i b0 = _mm_set1_epi8(sig_bytes[0]);
+    const __m128i b1 = _mm_set1_epi8(sig_bytes[1]);
+    const __m128i b2 = _mm_set1_epi8(sig_bytes[2]);
+    const __m128i b3 = _mm_set1_epi8(sig_bytes[3]);
+    
+    for(; i + 19 <= len; i += 16) {
+        const unsigned char* p = buf + i;
+        __m128i eq = _mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), b0),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), b1)),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 2)), b2),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 3)), b3)));
+        unsigned mask = _mm_movemask_epi8(eq);
+        
+        while(mask) {
+            unsigned bit = __builtin_ctz(mask);
+            
+            found.push_back(base + i + bit);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    
+    findScalar(buf + i, len - i, base + i, found);
+}
+
+std::vector<t_found_archive> findArchives(const std::string& filename)
+{
+    std::vector<t_found_archive> archives;
+    std::vector<uint64_t> candidates;
+    std::vector<unsigned char> buf(SCAN_CHUNK + 3);
+    uint64_t start = 0;
+    size_t carry = 0;
+    size_t len;
+    size_t n;
+    FILE* fh = fopen(filename.c_str(), "rb");
+    
+    if(!fh) throw "Could not open file.";
+    
+    //read in large chunks, carrying the last three bytes over so signatures
+    //straddling a chunk boundary are still seen
+    while((n = fread(&buf[carry], 1, SCAN_CHUNK, fh)) > 0) {
+        len = carry + n;
+        findSignatures(&buf[0], len, start, candidates);
+        
+        carry = len < 3 ? len : 3;
+        memmove(&buf[0], &buf[len - carry], carry);
+        start += len - carry;
+    }
+    
+    fclose(fh);
+    
+    //a signature alone is four bytes, only keep it if the rest parses
+    for(uint32_t i = 0; i < candidates.size(); i++) {
+        InstallShield archive;
+        std::string path = filename;
+        t_found_archive found;
+        
+        try {
+            archive.open(path, candidates[i]);
+        } catch (const char*) {
+            continue;
+        }
+        
+        found.offset = candidates[i];
+        found.files = archive.files().size();
+        archives.push_back(found);
+    }
+    
+    return archives;
+}
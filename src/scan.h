@@ -0,0 +1,33 @@
+/* 
+ * File:   scan.h
+ * 
+ * Locate InstallShield 3 archives embedded at any offset in a larger file,
+ * such as a disk image or a self extracting executable.
+ */
+
+#ifndef SCAN_H
+#define	SCAN_H
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+struct t_found_archive {
+    uint64_t offset;    //where the archive header starts
+    uint32_t files;     //members in its table of contents
+};
+
+//every offset in filename where the archive signature is followed by a
+//header and table of contents that parse. Throws if filename can't be read.
+std::vector<t_found_archive> findArchives(const std::string& filename);
+
+//offset of each occurrence of the archive signature in buf[0..len-1]
+void findSignatures(const unsigned char* buf, size_t len, uint64_t base,
+                    std::vector<uint64_t>& found);
+
+#endif	/* SCAN_H */
@@ -0,0 +1,505 @@
+#include "server.h"
+#include "threadpool.h"
+#include "dostime.h"
+
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+const uint32_t IO_CHUNK = 65536;
+
+AssetServer::AssetServer(unsigned threads, uint64_t cache_budget):
+m_cache(cache_budget),
+m_threads(threads)
+{
+    
+}
+
+AssetServer::~AssetServer()
+{
+    
+}
+
+void AssetServer::addArchive(std::string& filename, bool recover)
+{
+    std::unique_ptr<InstallShield> archive(new InstallShield());
+    
+    if(recover) {
+        archive->recover(filename);
+    } else {
+        archive->open(filename);
+    }
+
+    archive->setCache(&m_cache);
+    
+    m_archives.push_back(std::move(archive));
+    m_names.push_back(filename);
+}
+
+#ifndef _WIN32
+
+static volatile sig_atomic_t stop_serving = 0;
+
+static void stopHandler(int)
+{
+    stop_serving = 1;
+}
+
+static void put16(std::string& buf, uint16_t v)
+{
+    buf += char(v & 0xFF);
+    buf += char(v >> 8);
+}
+
+static void put32(std::string& buf, uint32_t v)
+{
+    put16(buf, v & 0xFFFF);
+    put16(buf, v >> 16);
+}
+
+static void put64(std::string& buf, uint64_t v)
+{
+    put32(buf, v & 0xFFFFFFFF);
+    put32(buf, v >> 32);
+}
+
+static uint16_t get16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const unsigned char* p)
+{
+    return get16(p) | (uint32_t(get16(p + 2)) << 16);
+}
+
+static uint64_t get64(const unsigned char* p)
+{
+    return get32(p) | (uint64_t(get32(p + 4)) << 32);
+}
+
+//false on error or if the peer closed before len bytes arrived
+static bool readAll(int fd, void* buf, size_t len)
+{
+    char* p = static_cast<char*>(buf);
+    
+    while(len) {
+        ssize_t n = read(fd, p, len);
+        
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        
+        p += n;
+        len -= n;
+    }
+    
+    return true;
+}
+
+static bool writeAll(int fd, const void* buf, size_t len)
+{
+    const char* p = static_cast<const char*>(buf);
+    
+    while(len) {
+        ssize_t n = write(fd, p, len);
+        
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        
+        p += n;
+        len -= n;
+    }
+    
+    return true;
+}
+
+static bool sendReply(int fd, t_server_status status, const std::string& payload)
+{
+    std::string header;
+    
+    header += char(status);
+    put64(header, payload.size());
+    
+    return writeAll(fd, header.data(), header.size())
+        && writeAll(fd, payload.data(), payload.size());
+}
+
+static void putEntry(std::string& buf, const InstallShield::t_entry& entry)
+{
+    put32(buf, entry.uncompressed_size);
+    put32(buf, entry.compressed_size);
+    put32(buf, entry.datetime);
+}
+
+//blast output straight onto a socket, counting what was sent
+struct t_socket_out {
+    int fd;
+    uint64_t sent;
+};
+
+static int sockf(void *how, unsigned char *buf, unsigned len)
+{
+    t_socket_out* out = (t_socket_out *)how;
+    
+    out->sent += len;
+    
+    return !writeAll(out->fd, buf, len);
+}
+
+bool AssetServer::sendMember(int fd, const InstallShield& archive, const std::string& name)
+{
+    const InstallShield::t_entry* entry = archive.findFile(name);
+    std::string header;
+    t_socket_out out;
+    
+    if(!entry) return sendReply(fd, SERVER_NO_MEMBER, "");
+    
+    //members that fit the cache go through it, so hot assets come from memory
+    if(m_cache.cacheable(entry->uncompressed_size)) {
+        MemberCache::t_data data = archive.readFile(name);
+        
+        if(!data) return sendReply(fd, SERVER_DECODE_ERROR, "");
+        
+        header += char(SERVER_OK);
+        put64(header, data->size());
+        
+        return writeAll(fd, header.data(), header.size())
+            && writeAll(fd, data->data(), data->size());
+    }
+    
+    //anything bigger is decoded onto the socket as it is produced, the
+    //length has to come from the index since it goes out first
+    header += char(SERVER_OK);
+    put64(header, entry->uncompressed_size);
+    
+    if(!writeAll(fd, header.data(), header.size())) return false;
+    
+    out.fd = fd;
+    out.sent = 0;
+    
+    return archive.decodeFile(name, sockf, &out) == 0
+        && out.sent == entry->uncompressed_size;
+}
+
+bool AssetServer::handleRequest(int fd)
+{
+    unsigned char header[5];
+    std::string name;
+    std::string payload;
+    uint16_t archive;
+    
+    if(!readAll(fd, header, sizeof(header))) return false;
+    
+    archive = get16(header + 1);
+    name.resize(get16(header + 3));
+    
+    if(!name.empty() && !readAll(fd, &name[0], name.size())) return false;
+    
+    if(header[0] == 'A') {
+        for(uint32_t i = 0; i < m_names.size(); i++) {
+            put16(payload, m_names[i].size());
+            payload += m_names[i];
+        }
+        
+        return sendReply(fd, SERVER_OK, payload);
+    }
+    
+    if(archive >= m_archives.size()) return sendReply(fd, SERVER_NO_ARCHIVE, "");
+    
+    const InstallShield& is = *m_archives[archive];
+    
+    switch(header[0]) {
+    case 'L':
+        for(InstallShield::t_file_map::const_iterator it = is.files().begin();
+            it != is.files().end(); it++) {
+            put16(payload, it->first.size());
+            payload += it->first;
+            putEntry(payload, it->second);
+        }
+        
+        return sendReply(fd, SERVER_OK, payload);
+    case 'S':
+        if(!is.findFile(name)) return sendReply(fd, SERVER_NO_MEMBER, "");
+        
+        putEntry(payload, *is.findFile(name));
+        
+        return sendReply(fd, SERVER_OK, payload);
+    case 'R':
+        return sendMember(fd, is, name);
+    default:
+        return sendReply(fd, SERVER_BAD_REQUEST, "");
+    }
+}
+
+//answer one request on a worker, then hand the connection back to serve()
+//to wait for the next, so idle clients don't hold on to a worker
+void AssetServer::serveRequest(int fd)
+{
+    bool open = handleRequest(fd);
+    std::lock_guard<std::mutex> guard(m_lock);
+    
+    if(!open) {
+        m_clients.erase(fd);
+        close(fd);
+        return;
+    }
+    
+    m_returned.push_back(fd);
+    
+    //a full pipe already has serve() on its way
+    char wake = 0;
+    ssize_t n = write(m_wake[1], &wake, 1);
+    (void)n;
+}
+
+bool AssetServer::serve(const std::string& path)
+{
+    struct sockaddr_un addr;
+    struct sigaction action;
+    std::vector<struct pollfd> fds;
+    std::set<int> idle;
+    sigset_t stop_signals;
+    sigset_t old_mask;
+    int listener;
+    
+    if(path.size() >= sizeof(addr.sun_path)) return false;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    
+    if(listener < 0) return false;
+    
+    unlink(path.c_str());
+    
+    if(bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0
+       || listen(listener, 64) != 0 || pipe(m_wake) != 0) {
+        close(listener);
+        return false;
+    }
+    
+    fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(m_wake[1], F_SETFL, O_NONBLOCK);
+    
+    //a client going away mid reply should only end that connection
+    signal(SIGPIPE, SIG_IGN);
+    
+    stop_serving = 0;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopHandler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    
+    //workers inherit the blocked mask so the stop signals land on this thread
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+    
+    {
+        ThreadPool pool(m_threads);
+        
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+        
+        //wait on new connections and on every connection between requests,
+        //a worker only gets one once it has a request to answer
+        while(!stop_serving) {
+            struct pollfd pfd;
+            char drain[64];
+            
+            fds.clear();
+            pfd.events = POLLIN;
+            pfd.fd = listener;
+            fds.push_back(pfd);
+            pfd.fd = m_wake[0];
+            fds.push_back(pfd);
+            
+            for(std::set<int>::iterator it = idle.begin(); it != idle.end(); it++) {
+                pfd.fd = *it;
+                fds.push_back(pfd);
+            }
+            
+            if(poll(&fds[0], fds.size(), 500) <= 0) continue;
+            
+            //readable, or hung up which the worker sees as the end
+            for(size_t i = 2; i < fds.size(); i++) {
+                if(!fds[i].revents) continue;
+                
+                idle.erase(fds[i].fd);
+                pool.submit(std::bind(&AssetServer::serveRequest, this, fds[i].fd));
+            }
+            
+            if(fds[1].revents) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                
+                while(read(m_wake[0], drain, sizeof(drain)) > 0) {}
+                
+                idle.insert(m_returned.begin(), m_returned.end());
+                m_returned.clear();
+            }
+            
+            if(fds[0].revents) {
+                int fd = accept(listener, NULL, NULL);
+                
+                if(fd < 0) continue;
+                
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_clients.insert(fd);
+                idle.insert(fd);
+            }
+        }
+        
+        close(listener);
+        unlink(path.c_str());
+        
+        //stop any worker part way through a reply, queued requests see eof
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            
+            for(std::set<int>::iterator it = m_clients.begin(); it != m_clients.end(); it++) {
+                shutdown(*it, SHUT_RDWR);
+            }
+        }
+    }
+    
+    //the workers are done, close what is left between requests
+    for(std::set<int>::iterator it = m_clients.begin(); it != m_clients.end(); it++) {
+        close(*it);
+    }
+    
+    m_clients.clear();
+    m_returned.clear();
+    close(m_wake[0]);
+    close(m_wake[1]);
+    
+    return true;
+}
+
+int queryServer(const std::string& path, char op, uint16_t archive,
+                const std::string& name, FILE* out)
+{
+    struct sockaddr_un addr;
+    std::string request;
+    unsigned char header[9];
+    std::vector<unsigned char> payload;
+    uint64_t remaining;
+    int fd;
+    
+    if(path.size() >= sizeof(addr.sun_path)) return -1;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    
+    if(fd < 0) return -1;
+    
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    request += op;
+    put16(request, archive);
+    put16(request, name.size());
+    request += name;
+    
+    if(!writeAll(fd, request.data(), request.size()) || !readAll(fd, header, sizeof(header))) {
+        close(fd);
+        return -1;
+    }
+    
+    remaining = get64(header + 1);
+    
+    //member content is passed through as it arrives
+    if(op == 'R') {
+        payload.resize(IO_CHUNK);
+        
+        while(remaining) {
+            uint32_t len = remaining < IO_CHUNK ? remaining : IO_CHUNK;
+            
+            if(!readAll(fd, &payload[0], len)) {
+                close(fd);
+                return -1;
+            }
+            
+            fwrite(&payload[0], 1, len, out);
+            remaining -= len;
+        }
+        
+        close(fd);
+        return header[0];
+    }
+    
+    payload.resize(remaining);
+    
+    if(remaining && !readAll(fd, &payload[0], remaining)) {
+        close(fd);
+        return -1;
+    }
+    
+    close(fd);
+    
+    //listings are printed one entry per line
+    for(size_t pos = 0; pos < payload.size(); ) {
+        std::string entry;
+        
+        if(op != 'S') {
+            if(pos + 2 > payload.size()) break;
+            
+            uint16_t nlen = get16(&payload[pos]);
+            
+            if(pos + 2 + nlen > payload.size()) break;
+            
+            entry.assign(reinterpret_cast<char*>(&payload[pos + 2]), nlen);
+            pos += nlen + 2;
+        }
+        
+        if(op != 'A') {
+            if(pos + 12 > payload.size()) break;
+            
+            time_t time = dos2unixtime(get32(&payload[pos + 8]));
+            char stamp[32];
+            
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&time));
+            
+            fprintf(out, "%s%s%u %u %s", entry.c_str(), entry.empty() ? "" : " ",
+                    get32(&payload[pos]), get32(&payload[pos + 4]), stamp);
+            pos += 12;
+        } else {
+            fputs(entry.c_str(), out);
+        }
+        
+        fputc('\n', out);
+    }
+    
+    return header[0];
+}
+
+#else
+
+bool AssetServer::serve(const std::string&)
+{
+    return false;
+}
+
+int queryServer(const std::string&, char, uint16_t, const std::string&, FILE*)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/* 
+ * File:   server.h
+ * 
+ * Long running asset server answering member requests for a set of open
+ * archives over a unix domain socket, and a matching client.
+ *
+ * Protocol, all integers are little endian. A connection carries any number
+ * of requests, each answered in order.
+ *
+ * request:  u8 op, u16 archive, u16 name length, name
+ * response: u8 status, u64 payload length, payload
+ *
+ * 'A' list the archives being served, archive and name are ignored. Payload
+ *     is u16 name length and name for each archive, index order.
+ * 'L' list the members of archive. Payload is u16 name length, name,
+ *     u32 uncompressed size, u32 compressed size, u32 dos datetime for each.
+ * 'S' stat member name of archive, payload is the three u32 fields of 'L'.
+ * 'R' read member name of archive, payload is the decoded content. Large
+ *     members are decoded straight onto the socket after the length is
+ *     sent, if decoding fails part way through the connection is closed.
+ */
+
+#ifndef SERVER_H
+#define	SERVER_H
+
+#include "isextract.h"
+#include "cache.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+enum t_server_status {
+    SERVER_OK,
+    SERVER_NO_ARCHIVE,
+    SERVER_NO_MEMBER,
+    SERVER_DECODE_ERROR,
+    SERVER_BAD_REQUEST
+};
+
+class AssetServer
+{
+public:
+    //threads of 0 uses one worker per hardware thread
+    AssetServer(unsigned threads, uint64_t cache_budget);
+    ~AssetServer();
+    
+    //open an archive to serve, or recover one if recover, throws as
+    //InstallShield::open does
+    void addArchive(std::string& filename, bool recover = false);
+    //serve on the socket at path until SIGINT or SIGTERM, false if the
+    //socket could not be set up
+    bool serve(const std::string& path);
+private:
+    void serveRequest(int fd);
+    bool handleRequest(int fd);
+    bool sendMember(int fd, const InstallShield& archive, const std::string& name);
+    
+    std::vector<std::unique_ptr<InstallShield> > m_archives;
+    std::vector<std::string> m_names;
+    MemberCache m_cache;
+    unsigned m_threads;
+    std::mutex m_lock;
+    std::set<int> m_clients;        //every open connection
+    std::vector<int> m_returned;    //answered, to wait on for the next request
+    int m_wake[2];                  //pipe telling serve() m_returned has grown
+};
+
+//send one request to the server at path and write the reply to out, listings
+//as text and member content raw. Returns the server status or -1 if the
+//server could not be reached.
+int queryServer(const std::string& path, char op, uint16_t archive,
+                const std::string& name, FILE* out);
+
+#endif	/* SERVER_H */
@@ -0,0 +1,157 @@
+#include "source.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FileSource::FileSource(const std::string& filename)
+{
+    std::ostringstream identity;
+    struct stat st;
+    
+#ifdef _WIN32
+    m_fh = fopen(filename.c_str(), "rb");
+    
+    if(!m_fh || stat(filename.c_str(), &st) != 0) {
+        if(m_fh) fclose(m_fh);
+        throw "Could not open file.";
+    }
+#else
+    m_fd = ::open(filename.c_str(), O_RDONLY);
+    
+    if(m_fd < 0 || fstat(m_fd, &st) != 0) {
+        if(m_fd >= 0) close(m_fd);
+        throw "Could not open file.";
+    }
+#endif
+    
+    m_size = st.st_size;
+    
+    //identifies this version of the file for cached members, a rewrite in
+    //place changes the size or mtime
+    identity << filename << ':' << st.st_dev << ':' << st.st_ino << ':'
+             << st.st_size << ':' << st.st_mtime;
+    m_identity = identity.str();
+}
+
+FileSource::~FileSource()
+{
+#ifdef _WIN32
+    fclose(m_fh);
+#else
+    close(m_fd);
+#endif
+}
+
+size_t FileSource::read(uint64_t offset, void* buf, size_t len) const
+{
+    size_t done = 0;
+    
+#ifdef _WIN32
+    std::lock_guard<std::mutex> guard(m_lock);
+    
+    if(_fseeki64(m_fh, offset, SEEK_SET) != 0) return 0;
+    
+    done = fread(buf, 1, len, m_fh);
+#else
+    //pread leaves no shared file position, so readers don't need a lock
+    while(done < len) {
+        ssize_t n = pread(m_fd, static_cast<char*>(buf) + done, len - done, offset + done);
+        
+        if(n <= 0) break;
+        
+        done += n;
+    }
+#endif
+    
+    return done;
+}
+
+#ifndef _WIN32
+void FileSource::advise(uint64_t offset, uint64_t len, t_advice advice) const
+{
+#ifdef POSIX_FADV_WILLNEED
+    static const int advices[] = {
+        POSIX_FADV_SEQUENTIAL, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED
+    };
+    
+    //only a hint, nothing to do if the kernel won't take it
+    posix_fadvise(m_fd, offset, len, advices[advice]);
+#else
+    (void)offset; (void)len; (void)advice;
+#endif
+}
+#endif
+
+MemorySource::MemorySource(const MemberCache::t_data& data, const std::string& identity):
+m_data(data),
+m_identity(identity)
+{
+    
+}
+
+size_t MemorySource::read(uint64_t offset, void* buf, size_t len) const
+{
+    if(offset >= m_data->size()) return 0;
+    
+    if(len > m_data->size() - offset) len = m_data->size() - offset;
+    
+    memcpy(buf, &(*m_data)[offset], len);
+    
+    return len;
+}
+
+SourceReader::SourceReader(const Source& source, uint64_t pos):
+m_source(source),
+m_pos(pos),
+m_next(0),
+m_len(0),
+m_good(true)
+{
+    
+}
+
+void SourceReader::seek(uint64_t pos)
+{
+    //stay in the buffer if we can, tocs are mostly skipped over in small steps
+    if(pos >= m_pos && pos <= m_pos + m_len) {
+        m_next = pos - m_pos;
+        return;
+    }
+    
+    m_pos = pos;
+    m_next = 0;
+    m_len = 0;
+}
+
+void SourceReader::read(void* buf, size_t len)
+{
+    unsigned char* out = static_cast<unsigned char*>(buf);
+    
+    while(len) {
+        if(m_next == m_len) {
+            m_pos += m_len;
+            m_next = 0;
+            m_len = m_source.read(m_pos, m_buf, sizeof(m_buf));
+            
+            if(m_len == 0) {
+                m_good = false;
+                memset(out, 0, len);
+                return;
+            }
+        }
+        
+        size_t n = m_len - m_next < len ? m_len - m_next : len;
+        
+        memcpy(out, m_buf + m_next, n);
+        m_next += n;
+        out += n;
+        len -= n;
+    }
+}
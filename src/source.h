@@ -0,0 +1,108 @@
+/* 
+ * File:   source.h
+ * 
+ * Where archive bytes come from, a file on disk or a buffer in memory.
+ */
+
+#ifndef SOURCE_H
+#define	SOURCE_H
+
+#include "cache.h"
+
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+//random access to the bytes of an archive, reads are safe from any thread
+class Source
+{
+public:
+    //hints about how a range will be read, for sources that can use them
+    enum t_advice {
+        ADVISE_SEQUENTIAL,  //read front to back, worth reading well ahead
+        ADVISE_WILLNEED,    //read soon, start fetching it now
+        ADVISE_DONTNEED     //not read again, don't keep it cached
+    };
+    
+    virtual ~Source() {}
+    //read up to len bytes at offset, returns how many were read
+    virtual size_t read(uint64_t offset, void* buf, size_t len) const = 0;
+    virtual uint64_t size() const = 0;
+    //distinguishes this content from any other source, see MemberCache::key
+    virtual std::string identity() const = 0;
+    //descriptor to copy from without a trip through memory, -1 if there is none
+    virtual int fd() const { return -1; }
+    //pass on a hint for len bytes at offset, 0 for to the end
+    virtual void advise(uint64_t offset, uint64_t len, t_advice advice) const
+    {
+        (void)offset; (void)len; (void)advice;
+    }
+};
+
+class FileSource : public Source
+{
+public:
+    //throws if filename can't be opened
+    explicit FileSource(const std::string& filename);
+    ~FileSource();
+    
+    size_t read(uint64_t offset, void* buf, size_t len) const;
+    uint64_t size() const { return m_size; }
+    std::string identity() const { return m_identity; }
+#ifndef _WIN32
+    int fd() const { return m_fd; }
+    //through to the page cache with posix_fadvise, where there is one
+    void advise(uint64_t offset, uint64_t len, t_advice advice) const;
+#endif
+private:
+#ifdef _WIN32
+    FILE* m_fh;
+    mutable std::mutex m_lock;
+#else
+    int m_fd;
+#endif
+    uint64_t m_size;
+    std::string m_identity;
+};
+
+//an archive held in memory, such as a member decoded from another archive
+class MemorySource : public Source
+{
+public:
+    MemorySource(const MemberCache::t_data& data, const std::string& identity);
+    
+    size_t read(uint64_t offset, void* buf, size_t len) const;
+    uint64_t size() const { return m_data->size(); }
+    std::string identity() const { return m_identity; }
+private:
+    MemberCache::t_data m_data;
+    std::string m_identity;
+};
+
+//buffered sequential reads from a source, for walking headers and tocs
+class SourceReader
+{
+public:
+    SourceReader(const Source& source, uint64_t pos);
+    
+    //false once any read came up short
+    bool good() const { return m_good; }
+    void read(void* buf, size_t len);
+    void skip(uint64_t len) { seek(tell() + len); }
+    void seek(uint64_t pos);
+    uint64_t tell() const { return m_pos + m_next; }
+private:
+    const Source& m_source;
+    uint64_t m_pos;         //source offset of m_buf[0]
+    size_t m_next;          //next unread byte in m_buf
+    size_t m_len;           //valid bytes in m_buf
+    bool m_good;
+    unsigned char m_buf[4096];
+};
+
+#endif	/* SOURCE_H */
@@ -0,0 +1,108 @@
+#include "stats.h"
+
+#ifdef ISX_STATS
+
+#include <atomic>
+#include <iomanip>
+
+static const char* const counter_names[STAT_COUNTERS] = {
+    "bytes_read",
+    "bytes_decoded",
+    "bytes_written",
+    "members",
+    "members_skipped",
+    "members_streamed",
+    "literals",
+    "matches",
+    "match_bytes",
+    "cache_hits",
+    "cache_misses"
+};
+
+static const char* const timer_names[STAT_TIMERS] = {
+    "open",
+    "toc",
+    "decode",
+    "read",
+    "write",
+    "utime",
+    "throttle"
+};
+
+//relaxed atomics, callers batch their updates so these stay off hot loops
+static std::atomic<uint64_t> counters[STAT_COUNTERS];
+static std::atomic<uint64_t> timers[STAT_TIMERS];
+
+void statAdd(t_stat_counter counter, uint64_t n)
+{
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void statTime(t_stat_timer timer, uint64_t ns)
+{
+    timers[timer].fetch_add(ns, std::memory_order_relaxed);
+}
+
+bool statsEnabled()
+{
+    return true;
+}
+
+void statsReport(std::ostream& os, bool json)
+{
+    uint64_t matches = counters[STAT_MATCHES].load();
+    uint64_t symbols = counters[STAT_LITERALS].load() + matches;
+    double avg_match = matches ? double(counters[STAT_MATCH_BYTES].load()) / matches : 0.0;
+    double io_ms = (timers[STAT_T_READ].load() + timers[STAT_T_WRITE].load()) / 1e6;
+    
+    if(json) {
+        os << "{";
+        
+        for(int i = 0; i < STAT_COUNTERS; i++) {
+            os << "\"" << counter_names[i] << "\": " << counters[i].load() << ", ";
+        }
+        
+        os << "\"symbols\": " << symbols << ", "
+           << "\"avg_match_length\": " << avg_match << ", "
+           << "\"time_ms\": {";
+        
+        for(int i = 0; i < STAT_TIMERS; i++) {
+            os << (i ? ", " : "") << "\"" << timer_names[i] << "\": "
+               << timers[i].load() / 1e6;
+        }
+        
+        os << ", \"io_blocked\": " << io_ms << "}}\n";
+        return;
+    }
+    
+    os << "Statistics:\n";
+    
+    for(int i = 0; i < STAT_COUNTERS; i++) {
+        os << "  " << std::left << std::setw(18) << counter_names[i]
+           << counters[i].load() << "\n";
+    }
+    
+    os << "  " << std::setw(18) << "symbols" << symbols << "\n"
+       << "  " << std::setw(18) << "avg_match_length" << avg_match << "\n"
+       << "Time (ms):\n";
+    
+    for(int i = 0; i < STAT_TIMERS; i++) {
+        os << "  " << std::setw(18) << timer_names[i] << timers[i].load() / 1e6 << "\n";
+    }
+    
+    os << "  " << std::setw(18) << "io_blocked" << io_ms << "\n";
+}
+
+#else
+
+bool statsEnabled()
+{
+    return false;
+}
+
+void statsReport(std::ostream& os, bool)
+{
+    os << "Statistics were not compiled in, rebuild with STATS=1.\n";
+}
+
+#endif
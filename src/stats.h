@@ -0,0 +1,90 @@
+/* 
+ * File:   stats.h
+ * 
+ * Run statistics, per phase timers and counters for the extraction path.
+ * Everything here compiles away to nothing unless ISX_STATS is defined.
+ */
+
+#ifndef STATS_H
+#define	STATS_H
+
+#include <ostream>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+enum t_stat_counter {
+    STAT_BYTES_READ,        //compressed bytes read from archives
+    STAT_BYTES_DECODED,     //bytes produced by blast
+    STAT_BYTES_WRITTEN,     //bytes written to extracted files
+    STAT_MEMBERS,           //members decoded
+    STAT_MEMBERS_SKIPPED,   //members skipped as already up to date
+    STAT_MEMBERS_STREAMED,  //members too big for the memory budget
+    STAT_LITERALS,          //literal symbols decoded
+    STAT_MATCHES,           //length/distance pairs decoded
+    STAT_MATCH_BYTES,       //bytes produced by length/distance pairs
+    STAT_CACHE_HITS,        //member reads served from the decoded cache
+    STAT_CACHE_MISSES,      //member reads that had to be decoded
+    STAT_COUNTERS
+};
+
+enum t_stat_timer {
+    STAT_T_OPEN,            //InstallShield::open, header and toc
+    STAT_T_TOC,             //parseDirs and parseFiles
+    STAT_T_DECODE,          //inside blast, including its reads and writes
+    STAT_T_READ,            //blocked reading compressed data
+    STAT_T_WRITE,           //blocked writing decoded data
+    STAT_T_UTIME,           //setting timestamps on extracted files
+    STAT_T_THROTTLE,        //waiting for the memory or open file budget
+    STAT_TIMERS
+};
+
+#ifdef ISX_STATS
+
+#include <chrono>
+
+void statAdd(t_stat_counter counter, uint64_t n);
+void statTime(t_stat_timer timer, uint64_t ns);
+
+//times the enclosing scope
+class StatTimer
+{
+public:
+    explicit StatTimer(t_stat_timer timer) :
+    m_timer(timer),
+    m_start(std::chrono::steady_clock::now())
+    {
+    }
+    
+    ~StatTimer()
+    {
+        std::chrono::steady_clock::duration elapsed =
+            std::chrono::steady_clock::now() - m_start;
+        
+        statTime(m_timer, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+private:
+    t_stat_timer m_timer;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define STAT_ADD(counter, n) statAdd((counter), (n))
+#define STAT_SCOPE(timer) StatTimer stat_timer_scope(timer)
+
+#else
+
+#define STAT_ADD(counter, n) do {} while(0)
+#define STAT_SCOPE(timer) do {} while(0)
+
+#endif
+
+//false if statistics were compiled out
+bool statsEnabled();
+
+//write the statistics gathered so far as a summary or as json
+void statsReport(std::ostream& os, bool json);
+
+#endif	/* STATS_H */
@@ -0,0 +1,147 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned threads):
+m_stop(false)
+{
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+    if(threads == 0) threads = 1;
+    
+    for(unsigned i = 0; i < threads; i++) {
+        m_workers.push_back(std::thread(&ThreadPool::run, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    
+    m_ready.notify_all();
+    
+    for(unsigned i = 0; i < m_workers.size(); i++) {
+        m_workers[i].join();
+    }
+}
+
+void ThreadPool::submit(const t_task& task)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_tasks.push_back(task);
+    }
+    
+    m_ready.notify_one();
+}
+
+void ThreadPool::run()
+{
+    t_task task;
+    
+    while(true) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            
+            while(!m_stop && m_tasks.empty()) m_ready.wait(guard);
+            
+            //only leave once the queue is drained
+            if(m_tasks.empty()) return;
+            
+            task = m_tasks.front();
+            m_tasks.pop_front();
+        }
+        
+        task();
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool* pool):
+m_pool(pool),
+m_pending(0),
+m_failed(false)
+{
+    
+}
+
+void TaskGroup::submit(const ThreadPool::t_task& task)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_pending++;
+    }
+    
+    if(!m_pool) {
+        run(task);
+        return;
+    }
+    
+    try {
+        m_pool->submit(std::bind(&TaskGroup::run, this, task));
+    } catch (...) {
+        //never queued, so nothing will finish it
+        std::lock_guard<std::mutex> guard(m_lock);
+    
+        if(--m_pending == 0) m_idle.notify_all();
+    
+        throw;
+    }
+}
+
+void TaskGroup::run(const ThreadPool::t_task& task)
+{
+    bool threw = false;
+    
+    //such as std::bad_alloc, which would otherwise terminate the worker's
+    //thread and leave wait() blocked for good
+    try {
+        task();
+    } catch (...) {
+        threw = true;
+    }
+    
+    std::lock_guard<std::mutex> guard(m_lock);
+    
+    if(threw) m_failed = true;
+    if(--m_pending == 0) m_idle.notify_all();
+}
+
+void TaskGroup::wait()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    
+    while(m_pending) m_idle.wait(guard);
+}
+
+bool TaskGroup::failed()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    
+    return m_failed;
+}
+
+Budget::Budget(uint64_t limit):
+m_limit(limit),
+m_used(0)
+{
+    
+}
+
+void Budget::acquire(uint64_t n)
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    
+    while(m_limit && m_used + n > m_limit) m_freed.wait(guard);
+    
+    m_used += n;
+}
+
+void Budget::release(uint64_t n)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_used -= n;
+    }
+    
+    m_freed.notify_all();
+}
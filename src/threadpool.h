@@ -0,0 +1,89 @@
+/* 
+ * File:   threadpool.h
+ * 
+ * Fixed size pool of worker threads running queued tasks in order.
+ */
+
+#ifndef THREADPOOL_H
+#define	THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+class ThreadPool
+{
+public:
+    typedef std::function<void()> t_task;
+    
+    //threads of 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned threads = 0);
+    //runs every task already queued, then joins the workers
+    ~ThreadPool();
+    
+    void submit(const t_task& task);
+    unsigned size() const { return m_workers.size(); }
+private:
+    void run();
+    
+    std::vector<std::thread> m_workers;
+    std::deque<t_task> m_tasks;
+    std::mutex m_lock;
+    std::condition_variable m_ready;
+    bool m_stop;
+};
+
+//tracks tasks submitted through it so a caller can wait for all of them,
+//including any those tasks submit in turn. Without a pool tasks run inline.
+//A task that throws is counted as finished and fails the group, an exception
+//must not reach a pool worker.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(ThreadPool* pool);
+    
+    //throws if the task could not be queued, it is then not run
+    void submit(const ThreadPool::t_task& task);
+    //block until every submitted task has finished, not from a pool worker
+    void wait();
+    //true if any task threw
+    bool failed();
+private:
+    void run(const ThreadPool::t_task& task);
+    
+    ThreadPool* m_pool;
+    std::mutex m_lock;
+    std::condition_variable m_idle;
+    unsigned m_pending;
+    bool m_failed;
+};
+
+//hands out a limited amount of something, such as bytes of memory or open
+//files, blocking callers that want more than is left until it is released
+class Budget
+{
+public:
+    //a limit of 0 never blocks
+    explicit Budget(uint64_t limit);
+    
+    uint64_t limit() const { return m_limit; }
+    //block until n more fit, n must not be more than the limit
+    void acquire(uint64_t n);
+    void release(uint64_t n);
+private:
+    uint64_t m_limit;
+    uint64_t m_used;
+    std::mutex m_lock;
+    std::condition_variable m_freed;
+};
+
+#endif	/* THREADPOOL_H */
@@ -0,0 +1,196 @@
+#include "writer.h"
+#include "stats.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//header layout, see InstallShield::open
+const uint32_t HEADER_SIZE = 255;
+const uint32_t MAX_DIR_FILES = 0xFFFF;
+const uint32_t COPY_CHUNK = 1 << 20;
+
+static void put16(std::vector<unsigned char>& buf, size_t at, uint16_t v)
+{
+    buf[at] = v & 0xFF;
+    buf[at + 1] = v >> 8;
+}
+
+static void put32(std::vector<unsigned char>& buf, size_t at, uint32_t v)
+{
+    put16(buf, at, v & 0xFFFF);
+    put16(buf, at + 2, v >> 16);
+}
+
+ArchiveWriter::ArchiveWriter(const std::string& filename):
+m_datasize(0)
+{
+#ifdef _WIN32
+    m_fh = fopen(filename.c_str(), "wb");
+    
+    if(!m_fh) throw "Could not create file.";
+#else
+    m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    
+    if(m_fd < 0) throw "Could not create file.";
+#endif
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+#ifdef _WIN32
+    fclose(m_fh);
+#else
+    close(m_fd);
+#endif
+}
+
+bool ArchiveWriter::writeAt(uint64_t offset, const void* buf, size_t len)
+{
+    STAT_ADD(STAT_BYTES_WRITTEN, len);
+    
+#ifdef _WIN32
+    return _fseeki64(m_fh, offset, SEEK_SET) == 0 && fwrite(buf, 1, len, m_fh) == len;
+#else
+    size_t done = 0;
+    
+    while(done < len) {
+        ssize_t n = pwrite(m_fd, static_cast<const char*>(buf) + done, len - done, offset + done);
+        
+        if(n <= 0) return false;
+        
+        done += n;
+    }
+    
+    return true;
+#endif
+}
+
+bool ArchiveWriter::copyFrom(const Source& source, uint64_t from, uint64_t to, uint64_t len)
+{
+    std::vector<unsigned char> buf;
+    
+#ifdef __linux__
+    //let the kernel move the bytes, or share extents on filesystems that can
+    if(source.fd() >= 0) {
+        loff_t in = from;
+        loff_t out = to;
+        
+        while(len) {
+            ssize_t n = copy_file_range(source.fd(), &in, m_fd, &out, len, 0);
+            
+            //not supported between these files, finish with plain reads
+            if(n <= 0) break;
+            
+            STAT_ADD(STAT_BYTES_READ, n);
+            STAT_ADD(STAT_BYTES_WRITTEN, n);
+            len -= n;
+        }
+        
+        from = in;
+        to = out;
+    }
+#endif
+    
+    buf.resize(len < COPY_CHUNK ? len : COPY_CHUNK);
+    
+    while(len) {
+        size_t want = len < buf.size() ? len : buf.size();
+        size_t n = source.read(from, &buf[0], want);
+        
+        STAT_ADD(STAT_BYTES_READ, n);
+        
+        if(n != want || !writeAt(to, &buf[0], n)) return false;
+        
+        from += n;
+        to += n;
+        len -= n;
+    }
+    
+    return true;
+}
+
+bool ArchiveWriter::addMember(const InstallShield& archive, const std::string& name)
+{
+    const InstallShield::t_entry* entry = archive.findFile(name);
+    t_member member;
+    
+    if(!entry || !archive.source() || m_names.count(name)) return false;
+    
+    //keep whatever the first archive had in the fields we don't understand
+    if(m_header.empty()) {
+        m_header.resize(HEADER_SIZE);
+        
+        if(archive.source()->read(archive.base(), &m_header[0], HEADER_SIZE) != HEADER_SIZE)
+            return false;
+    }
+    
+    if(!copyFrom(*archive.source(), archive.dataOffset(*entry),
+                 HEADER_SIZE + m_datasize, entry->compressed_size)) {
+        return false;
+    }
+    
+    member.first = name;
+    member.second = *entry;
+    member.second.offset = m_datasize;
+    m_members.push_back(member);
+    m_names.insert(name);
+    m_datasize += entry->compressed_size;
+    
+    return true;
+}
+
+void ArchiveWriter::finish()
+{
+    std::vector<unsigned char> toc;
+    uint64_t toc_address = HEADER_SIZE + m_datasize;
+    uint32_t dir_count = (m_members.size() + MAX_DIR_FILES - 1) / MAX_DIR_FILES;
+    
+    //an empty archive still needs a header to be valid
+    if(m_header.empty()) m_header.resize(HEADER_SIZE);
+    
+    //directories carry no name, only the file count the entries after them
+    //are split up by, and a directory can only count to 65535
+    for(uint32_t i = 0; i < dir_count; i++) {
+        uint32_t files = m_members.size() - i * MAX_DIR_FILES;
+        
+        toc.resize(toc.size() + 6);
+        put16(toc, toc.size() - 6, files < MAX_DIR_FILES ? files : MAX_DIR_FILES);
+        put16(toc, toc.size() - 4, 6);
+        put16(toc, toc.size() - 2, 0);
+    }
+    
+    //30 bytes of fixed fields then the name, as InstallShield::parseFiles
+    //reads them. Fields it skips are left zero.
+    for(uint32_t i = 0; i < m_members.size(); i++) {
+        const std::string& name = m_members[i].first;
+        const InstallShield::t_entry& entry = m_members[i].second;
+        size_t at = toc.size();
+        
+        toc.resize(at + 30 + name.size());
+        put32(toc, at + 3, entry.uncompressed_size);
+        put32(toc, at + 7, entry.compressed_size);
+        put16(toc, at + 15, entry.datetime >> 16);
+        put16(toc, at + 17, entry.datetime & 0xFFFF);
+        put16(toc, at + 23, 30 + name.size());
+        toc[at + 29] = name.size();
+        memcpy(&toc[at + 30], name.data(), name.size());
+    }
+    
+    //sizes and addresses only keep their low 32 bits, open() finds the toc
+    //of an archive past 4GiB from what is left
+    put32(m_header, 0, 0x8C655D13);
+    put16(m_header, 12, m_members.size() < MAX_DIR_FILES ? m_members.size() : MAX_DIR_FILES);
+    put32(m_header, 18, toc_address + toc.size());
+    put32(m_header, 41, toc_address);
+    put16(m_header, 49, dir_count);
+    
+    if((!toc.empty() && !writeAt(toc_address, &toc[0], toc.size()))
+       || !writeAt(0, &m_header[0], m_header.size())) {
+        throw "Could not write archive.";
+    }
+}
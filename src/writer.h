@@ -0,0 +1,49 @@
+/* 
+ * File:   writer.h
+ * 
+ * Builds a new InstallShield 3 archive out of members of existing ones by
+ * copying their compressed data as is, so nothing is decoded or recompressed.
+ */
+
+#ifndef WRITER_H
+#define	WRITER_H
+
+#include "isextract.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+class ArchiveWriter
+{
+public:
+    //throws if filename can't be created
+    explicit ArchiveWriter(const std::string& filename);
+    ~ArchiveWriter();
+    
+    //append the compressed data of a member of archive, false if the name is
+    //already taken or the data couldn't be copied
+    bool addMember(const InstallShield& archive, const std::string& name);
+    //compressed bytes added so far
+    uint64_t dataSize() const { return m_datasize; }
+    unsigned members() const { return m_members.size(); }
+    //write the table of contents and header, throws on failure
+    void finish();
+private:
+    typedef std::pair<std::string, InstallShield::t_entry> t_member;
+    
+    bool writeAt(uint64_t offset, const void* buf, size_t len);
+    bool copyFrom(const Source& source, uint64_t from, uint64_t to, uint64_t len);
+    
+#ifdef _WIN32
+    FILE* m_fh;
+#else
+    int m_fd;
+#endif
+    std::vector<t_member> m_members;
+    std::set<std::string> m_names;
+    std::vector<unsigned char> m_header;    //from the first archive added from
+    uint64_t m_datasize;
+};
+
+#endif	/* WRITER_H */
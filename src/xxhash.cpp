@@ -0,0 +1,139 @@
+#include "xxhash.h"
+
+#include <cstring>
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+//input is little endian whatever the host is
+static inline uint64_t read64(const unsigned char* p)
+{
+    return uint64_t(p[0]) | uint64_t(p[1]) << 8 | uint64_t(p[2]) << 16 | uint64_t(p[3]) << 24
+         | uint64_t(p[4]) << 32 | uint64_t(p[5]) << 40 | uint64_t(p[6]) << 48 | uint64_t(p[7]) << 56;
+}
+
+static inline uint32_t read32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+static inline uint64_t mix(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME2;
+    acc = rotl(acc, 31);
+    
+    return acc * PRIME1;
+}
+
+static inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= mix(0, val);
+    
+    return acc * PRIME1 + PRIME4;
+}
+
+XXH64::XXH64(uint64_t seed):
+m_seed(seed),
+m_total(0),
+m_buflen(0)
+{
+    m_acc[0] = seed + PRIME1 + PRIME2;
+    m_acc[1] = seed + PRIME2;
+    m_acc[2] = seed;
+    m_acc[3] = seed - PRIME1;
+}
+
+int XXH64::sink(void *how, unsigned char *buf, unsigned len)
+{
+    static_cast<XXH64*>(how)->update(buf, len);
+    
+    return 0;
+}
+
+void XXH64::update(const void* data, size_t len)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + len;
+    
+    m_total += len;
+    
+    //top up a partial stripe from the last call first
+    if(m_buflen) {
+        size_t n = 32 - m_buflen < len ? 32 - m_buflen : len;
+        
+        memcpy(m_buf + m_buflen, p, n);
+        m_buflen += n;
+        p += n;
+        
+        if(m_buflen < 32) return;
+        
+        for(int i = 0; i < 4; i++) {
+            m_acc[i] = mix(m_acc[i], read64(m_buf + i * 8));
+        }
+        
+        m_buflen = 0;
+    }
+    
+    while(end - p >= 32) {
+        m_acc[0] = mix(m_acc[0], read64(p));
+        m_acc[1] = mix(m_acc[1], read64(p + 8));
+        m_acc[2] = mix(m_acc[2], read64(p + 16));
+        m_acc[3] = mix(m_acc[3], read64(p + 24));
+        p += 32;
+    }
+    
+    memcpy(m_buf, p, end - p);
+    m_buflen = end - p;
+}
+
+uint64_t XXH64::digest() const
+{
+    const unsigned char* p = m_buf;
+    const unsigned char* end = m_buf + m_buflen;
+    uint64_t h;
+    
+    if(m_total >= 32) {
+        h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+        
+        for(int i = 0; i < 4; i++) {
+            h = mergeRound(h, m_acc[i]);
+        }
+    } else {
+        h = m_seed + PRIME5;
+    }
+    
+    h += m_total;
+    
+    for(; end - p >= 8; p += 8) {
+        h ^= mix(0, read64(p));
+        h = rotl(h, 27) * PRIME1 + PRIME4;
+    }
+    
+    if(end - p >= 4) {
+        h ^= uint64_t(read32(p)) * PRIME1;
+        h = rotl(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    
+    for(; p < end; p++) {
+        h ^= *p * PRIME5;
+        h = rotl(h, 11) * PRIME1;
+    }
+    
+    //final avalanche
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    
+    return h;
+}
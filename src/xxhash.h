@@ -0,0 +1,37 @@
+/* 
+ * File:   xxhash.h
+ * 
+ * Streaming XXH64, Yann Collet's 64 bit xxHash, for hashing decoded members
+ * as they come out of blast without holding them in memory.
+ */
+
+#ifndef XXHASH_H
+#define	XXHASH_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include "win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+class XXH64
+{
+public:
+    explicit XXH64(uint64_t seed = 0);
+    
+    void update(const void* data, size_t len);
+    //hash of everything so far, more can still be added after
+    uint64_t digest() const;
+    //blast output function adding the output to the XXH64 at how
+    static int sink(void *how, unsigned char *buf, unsigned len);
+private:
+    uint64_t m_acc[4];
+    uint64_t m_seed;
+    uint64_t m_total;
+    unsigned char m_buf[32];    //input short of a whole stripe
+    size_t m_buflen;
+};
+
+#endif	/* XXHASH_H */
@@ -0,0 +1,100 @@
+/*
+ * File:   blast_bench.cpp
+ *
+ * Decoding speed of blast() for every literal mode and dictionary size, built
+ * optimized and run by make bench.
+ */
+
+#include "implode.h"
+#include "../src/blast.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+const size_t DATA_SIZE = 1 << 20;
+
+struct t_feed {
+    const t_stream* data;
+    bool given;
+};
+
+static unsigned feedf(void *how, unsigned char **buf)
+{
+    t_feed* in = (t_feed *)how;
+    
+    if(in->given) return 0;
+    
+    in->given = true;
+    *buf = const_cast<unsigned char*>(in->data->data());
+    
+    return in->data->size();
+}
+
+//output is only counted, as a decoder writing into its caller's buffer would
+static int countf(void *how, unsigned char *buf, unsigned len)
+{
+    *(size_t *)how += len;
+    
+    return buf ? 0 : 1;
+}
+
+//text like data, words from a small vocabulary and some noise
+static t_stream makeData(std::mt19937& rng)
+{
+    static const char* const words[] = {
+        "the ", "archive ", "install ", "shield ", "data ", "of ", "a ", "to ",
+        "compression ", "library\n", "window ", "dictionary "
+    };
+    t_stream data;
+    
+    while(data.size() < DATA_SIZE) {
+        if(rng() % 8 == 0) {
+            data.push_back(rng());
+            continue;
+        }
+    
+        for(const char* w = words[rng() % 12]; *w; w++) data.push_back(*w);
+    }
+    
+    data.resize(DATA_SIZE);
+    
+    return data;
+}
+
+//blast_bench (rounds), best of rounds decodes per mode, 20 by default
+int main(int argc, char** argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    std::mt19937 rng(1);
+    t_stream data = makeData(rng);
+    
+    printf("blast %u KB of text, MB/s best of %d\n", unsigned(DATA_SIZE >> 10), rounds);
+    
+    for(int lit = 0; lit <= 1; lit++) {
+        for(int dict = 4; dict <= 6; dict++) {
+            t_stream stream = implode(data, lit, dict);
+            double best = 0;
+    
+            for(int i = 0; i < rounds; i++) {
+                t_feed in = {&stream, false};
+                size_t out = 0;
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    
+                if(blast(feedf, &in, countf, &out, NULL, NULL) != 0 || out != data.size()) {
+                    printf("lit %d dict %d: decode failed\n", lit, dict);
+                    return 1;
+                }
+    
+                std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    
+                if(data.size() / took.count() > best) best = data.size() / took.count();
+            }
+    
+            printf("  lit %d dict %d  %7.1f\n", lit, dict, best / (1 << 20));
+        }
+    }
+    
+    return 0;
+}
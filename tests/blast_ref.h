@@ -0,0 +1,22 @@
+/*
+ * File:   blast_ref.h
+ *
+ * blast() as released, decoding unchanged in blast_ref.cpp so that changes to
+ * the decoder in src/blast.cpp can be shown to decode exactly as the original
+ * does, errors included. Its changes are listed there. Only built into the
+ * tests.
+ */
+
+#ifndef BLAST_REF_H
+#define	BLAST_REF_H
+
+#include "../src/blast.h"
+
+//slower than blast() and not safe to call from several threads until it has
+//run once
+int blast_ref(blast_in infun, void *inhow, blast_out outfun, void *outhow);
+//the original construct(), building the decoding tables of the code whose
+//compacted lengths are the n bytes at rep into count[0..13] and symbol[]
+int blast_ref_construct(short *count, short *symbol, const unsigned char *rep, int n);
+
+#endif	/* BLAST_REF_H */
@@ -0,0 +1,385 @@
+/*
+ * File:   blast_tests.cpp
+ *
+ * Differential check of blast() against the unaltered reference in
+ * blast_ref.cpp. Both decode generated streams, random mutations of them and
+ * any files given, and their return codes and output must match exactly.
+ * Built with ISX_FUZZ, by make fuzz, it is a libFuzzer target instead.
+ */
+
+#include "blast_ref.h"
+#include "implode.h"
+#include "../src/isextract.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+const unsigned MAX_REPORTS = 16;
+
+//input handed to the decoders in chunks of a given size
+struct t_feed {
+    const unsigned char* data;
+    size_t len;
+    size_t pos;
+    size_t chunk;
+};
+
+static unsigned feedf(void *how, unsigned char **buf)
+{
+    t_feed* in = (t_feed *)how;
+    size_t n = in->len - in->pos;
+    
+    if(in->chunk && n > in->chunk) n = in->chunk;
+    
+    *buf = const_cast<unsigned char*>(in->data + in->pos);
+    in->pos += n;
+    
+    return n;
+}
+
+//output collected in memory, failing once it would pass limit
+struct t_collect {
+    t_stream data;
+    size_t limit;
+};
+
+static int collectf(void *how, unsigned char *buf, unsigned len)
+{
+    t_collect* out = (t_collect *)how;
+    
+    if(out->limit && out->data.size() + len > out->limit) return 1;
+    
+    out->data.insert(out->data.end(), buf, buf + len);
+    
+    return 0;
+}
+
+//decode data with both blast() and blast_ref(), feeding input chunk bytes
+//at a time and failing output after limit bytes (0 for never). True if the
+//return codes and output agree.
+static bool sameDecode(const unsigned char* data, size_t len, size_t chunk = 0, size_t limit = 0)
+{
+    t_feed in_a = {data, len, 0, chunk};
+    t_feed in_b = {data, len, 0, chunk};
+    t_collect out_a;
+    t_collect out_b;
+    int rv_a;
+    int rv_b;
+    
+    out_a.limit = limit;
+    out_b.limit = limit;
+    
+    rv_a = blast(feedf, &in_a, collectf, &out_a, NULL, NULL);
+    rv_b = blast_ref(feedf, &in_b, collectf, &out_b);
+    
+    return rv_a == rv_b && out_a.data == out_b.data;
+}
+
+//running totals, and valid streams kept for the random rounds to mutate
+struct t_results {
+    unsigned checked;
+    unsigned mismatches;
+    std::vector<t_stream> pool;
+};
+
+static void check(t_results& results, const t_stream& stream, const std::string& what,
+                  size_t chunk = 0, size_t limit = 0)
+{
+    std::ostringstream name;
+    FILE* fh;
+    
+    results.checked++;
+    
+    if(sameDecode(stream.empty() ? NULL : &stream[0], stream.size(), chunk, limit)) return;
+    
+    //one broken path tends to fail everything after it, the first few will do
+    if(results.mismatches++ >= MAX_REPORTS) return;
+    
+    name << "blast-mismatch-" << results.mismatches - 1 << ".dcl";
+    std::cout << "Mismatch: " << what << ", chunk " << chunk << ", limit " << limit
+              << ", saved to " << name.str() << "\n";
+    
+    if((fh = fopen(name.str().c_str(), "wb"))) {
+        fwrite(stream.data(), 1, stream.size(), fh);
+        fclose(fh);
+    }
+}
+
+static t_stream makeData(int kind, size_t size, std::mt19937& rng)
+{
+    static const char* const words[] = {
+        "the ", "archive ", "install ", "shield ", "data ", "of ", "a ", "to ",
+        "compression ", "library\n", "window ", "dictionary "
+    };
+    t_stream data;
+    
+    while(data.size() < size) {
+        switch(kind) {
+        case 0:
+            data.push_back(rng());
+            break;
+        case 1:
+            //few symbols, lots of short and overlapping matches
+            data.push_back('a' + rng() % 4);
+            break;
+        case 2:
+            //runs long enough for the longest matches
+            data.push_back(0);
+            break;
+        case 3:
+            for(const char* w = words[rng() % 12]; *w; w++) data.push_back(*w);
+            break;
+        default:
+            data.push_back(data.size() & 0xFF);
+            break;
+        }
+    }
+    
+    data.resize(size);
+    
+    return data;
+}
+
+//streams for every mode, with each in chunks of one byte and running out of
+//output part way through
+static void checkGenerated(t_results& results, std::mt19937& rng)
+{
+    static const size_t sizes[] = {0, 1, 2, 3, 17, 4095, 4096, 4097, 8193, 70000};
+    
+    for(int kind = 0; kind < 5; kind++) {
+        for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            t_stream data = makeData(kind, sizes[i], rng);
+    
+            for(int lit = 0; lit < 2; lit++) {
+                for(int dict = 4; dict <= 6; dict++) {
+                    std::ostringstream what;
+                    t_stream stream = implode(data, lit, dict);
+    
+                    what << "kind " << kind << " size " << sizes[i]
+                         << " lit " << lit << " dict " << dict;
+                    check(results, stream, what.str());
+                    check(results, stream, what.str(), 1);
+    
+                    if(sizes[i]) check(results, stream, what.str(), 0, sizes[i] / 2 + 1);
+    
+                    if(sizes[i] <= 8193) results.pool.push_back(stream);
+                }
+            }
+        }
+    }
+}
+
+static void checkEdges(t_results& results)
+{
+    //bad literal flag and dictionary sizes, and headers cut short
+    for(int lit = 0; lit <= 2; lit++) {
+        for(int dict = 3; dict <= 7; dict++) {
+            BitWriter out;
+    
+            out.put(lit, 8);
+            out.put(dict, 8);
+            putLiteral(out, 'x', lit == 1);
+            putEnd(out);
+            check(results, out.finish(), "header");
+        }
+    }
+    
+    for(size_t len = 0; len < 2; len++) {
+        check(results, t_stream(len, 1), "short header");
+    }
+    
+    //distances one past and right at the start of the output, which is only
+    //an error within the first 4K
+    for(int dict = 4; dict <= 6; dict++) {
+        static const unsigned before[] = {0, 1, 5, 255, 4095, 4096, 5000};
+    
+        for(size_t i = 0; i < sizeof(before) / sizeof(before[0]); i++) {
+            for(unsigned len = 2; len <= 3; len++) {
+                for(unsigned dist = before[i]; dist <= before[i] + 1; dist++) {
+                    BitWriter out;
+    
+                    if(dist == 0 || dist > (len == 2 ? 256u : 64u << dict)) continue;
+    
+                    out.put(0, 8);
+                    out.put(dict, 8);
+    
+                    for(unsigned j = 0; j < before[i]; j++) {
+                        putLiteral(out, j, 0);
+                    }
+    
+                    putMatch(out, len, dist, dict);
+                    putEnd(out);
+                    check(results, out.finish(), "distance");
+                }
+            }
+        }
+    }
+    
+    //every truncation of some short streams, and bytes after the end code
+    for(size_t i = 0; i < results.pool.size(); i++) {
+        const t_stream& stream = results.pool[i];
+        t_stream trailing = stream;
+    
+        if(stream.size() > 400) continue;
+    
+        for(size_t len = 0; len < stream.size(); len++) {
+            check(results, t_stream(stream.begin(), stream.begin() + len), "truncated");
+        }
+    
+        trailing.insert(trailing.end(), 16, 0xA5);
+        check(results, trailing, "trailing");
+    }
+}
+
+//blast()'s compile time tables against the original construct() at run time
+static void checkTables(t_results& results)
+{
+    static const char* const names[] = {"literal", "length", "distance"};
+    static const unsigned char* const reps[] = {blast_litlen, blast_lenlen, blast_distlen};
+    static const int sizes[] = {
+        sizeof(blast_litlen), sizeof(blast_lenlen), sizeof(blast_distlen)
+    };
+    
+    for(int code = 0; code < 3; code++) {
+        const short* count;
+        const short* symbol;
+        short ref_count[14];
+        short ref_symbol[256];
+        int n = blast_table(code, &count, &symbol);
+        bool same;
+    
+        results.checked++;
+    
+        same = blast_ref_construct(ref_count, ref_symbol, reps[code], sizes[code]) == 0
+               && memcmp(count, ref_count, sizeof(ref_count)) == 0;
+    
+        //only as many symbols as have codes are filled in
+        for(int i = 0; same && i < n - ref_count[0]; i++) {
+            same = symbol[i] == ref_symbol[i];
+        }
+    
+        if(!same) {
+            results.mismatches++;
+            std::cout << "Mismatch: " << names[code] << " code table\n";
+        }
+    }
+}
+
+static void checkRandom(t_results& results, unsigned rounds, std::mt19937& rng)
+{
+    for(unsigned i = 0; i < rounds && !results.pool.empty(); i++) {
+        t_stream stream = results.pool[rng() % results.pool.size()];
+        size_t chunk = rng() % 2 ? 0 : 1 + rng() % 16;
+        size_t limit = rng() % 8 ? 0 : rng() % 8192;
+    
+        switch(rng() % 4) {
+        case 0:
+            //flip a few bits, leaving the header alone
+            for(unsigned j = 1 + rng() % 8; j && stream.size() > 2; j--) {
+                stream[2 + rng() % (stream.size() - 2)] ^= 1 << (rng() % 8);
+            }
+            break;
+        case 1:
+            stream.resize(rng() % (stream.size() + 1));
+            break;
+        case 2:
+            for(unsigned j = rng() % 64; j && stream.size() > 2; j--) {
+                stream[2 + rng() % (stream.size() - 2)] = rng();
+            }
+            break;
+        default:
+            stream.resize(2 + rng() % 512);
+            stream[0] = rng() % 2;
+            stream[1] = 4 + rng() % 3;
+    
+            for(size_t j = 2; j < stream.size(); j++) {
+                stream[j] = rng();
+            }
+            break;
+        }
+    
+        check(results, stream, "random", chunk, limit);
+    }
+}
+
+static void checkCorpus(t_results& results, const std::string& filepath)
+{
+    InstallShield archive;
+    std::string path = filepath;
+    t_stream data;
+    unsigned char buf[16384];
+    size_t len;
+    FILE* fh = fopen(filepath.c_str(), "rb");
+    
+    if(!fh) {
+        std::cout << "Error: Could not open " << filepath << "\n";
+        return;
+    }
+    
+    while((len = fread(buf, 1, sizeof(buf), fh)) > 0) {
+        data.insert(data.end(), buf, buf + len);
+    }
+    
+    fclose(fh);
+    check(results, data, filepath);
+    
+    try {
+        archive.open(path);
+    } catch (const char*) {
+        return;
+    }
+    
+    for(InstallShield::t_file_map::const_iterator it = archive.files().begin();
+        it != archive.files().end(); it++) {
+        t_stream member(it->second.compressed_size);
+    
+        if(member.empty() || archive.source()->read(archive.dataOffset(it->second), &member[0],
+                                                    member.size()) == member.size()) {
+            check(results, member, filepath + ": " + it->first);
+        }
+    }
+}
+
+#ifdef ISX_FUZZ
+//blast.cpp has to be built with the fuzzer too for it to steer by coverage,
+//make fuzz builds everything that way
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if(!sameDecode(data, size) || !sameDecode(data, size, 1)) abort();
+    
+    return 0;
+}
+#else
+//blast_tests [rounds] (file)...
+//runs generated streams for every literal and dictionary mode and edge case,
+//rounds of random mutations of them, then every file given as a raw stream
+//and, if it is an archive, each member's compressed data. Streams that decode
+//differently are saved to blast-mismatch-N.dcl, the first 16 of them.
+int main(int argc, char** argv)
+{
+    t_results results;
+    std::mt19937 rng(1);
+    unsigned rounds = argc > 1 ? atoi(argv[1]) : 1000;
+    
+    results.checked = 0;
+    results.mismatches = 0;
+    
+    checkGenerated(results, rng);
+    checkEdges(results);
+    checkTables(results);
+    checkRandom(results, rounds, rng);
+    
+    for(int i = 2; i < argc; i++) {
+        checkCorpus(results, argv[i]);
+    }
+    
+    std::cout << "Checked " << results.checked << " streams, " << results.mismatches
+              << " decoded differently.\n";
+    
+    return results.mismatches ? 1 : 0;
+}
+#endif
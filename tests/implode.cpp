@@ -0,0 +1,171 @@
+/*
+ * File:   implode.cpp
+ *
+ * A plain DCL encoder, enough to produce streams in every literal mode and
+ * dictionary size for the tests and benchmarks to decode.
+ */
+
+#include "implode.h"
+#include "../src/blast.h"
+
+#include <cstddef>
+
+//length codes in the same order as blast.cpp's base and extra
+static const short base[16] = {
+    3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+static const char extra[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+const unsigned MAX_MATCH = 518;
+const unsigned END_CODE = 519;
+const unsigned MAX_TRIES = 16;
+
+//canonical codes in the order blast's construct() assigns them
+static std::vector<t_code> buildCodes(const unsigned char* rep, size_t n)
+{
+    std::vector<int> lengths;
+    std::vector<t_code> codes;
+    int count[14] = {0};
+    unsigned next[14];
+    unsigned code = 0;
+    
+    for(size_t i = 0; i < n; i++) {
+        lengths.insert(lengths.end(), (rep[i] >> 4) + 1, rep[i] & 15);
+    }
+    
+    for(size_t i = 0; i < lengths.size(); i++) {
+        count[lengths[i]]++;
+    }
+    
+    for(int len = 1; len < 14; len++) {
+        next[len] = code;
+        code = (code + count[len]) << 1;
+    }
+    
+    codes.resize(lengths.size());
+    
+    for(size_t i = 0; i < lengths.size(); i++) {
+        codes[i].len = lengths[i];
+        codes[i].code = lengths[i] ? next[lengths[i]]++ : 0;
+    }
+    
+    return codes;
+}
+
+static void putLength(BitWriter& out, unsigned len)
+{
+    static const std::vector<t_code> lencode = buildCodes(blast_lenlen, sizeof(blast_lenlen));
+    
+    for(int sym = 0; sym < 16; sym++) {
+        if(len >= unsigned(base[sym]) && len < unsigned(base[sym]) + (1u << extra[sym])) {
+            out.code(lencode[sym]);
+            out.put(len - base[sym], extra[sym]);
+            return;
+        }
+    }
+}
+
+void putMatch(BitWriter& out, unsigned len, unsigned dist, int dict)
+{
+    static const std::vector<t_code> distcode = buildCodes(blast_distlen, sizeof(blast_distlen));
+    int shift = len == 2 ? 2 : dict;
+    
+    dist--;
+    out.put(1, 1);
+    putLength(out, len);
+    out.code(distcode[dist >> shift]);
+    out.put(dist & ((1u << shift) - 1), shift);
+}
+
+void putLiteral(BitWriter& out, unsigned char c, int lit)
+{
+    static const std::vector<t_code> litcode = buildCodes(blast_litlen, sizeof(blast_litlen));
+    
+    out.put(0, 1);
+    
+    if(lit) {
+        out.code(litcode[c]);
+    } else {
+        out.put(c, 8);
+    }
+}
+
+void putEnd(BitWriter& out)
+{
+    out.put(1, 1);
+    putLength(out, END_CODE);
+}
+
+static unsigned hash3(const unsigned char* p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> 16;
+}
+
+t_stream implode(const t_stream& data, int lit, int dict)
+{
+    const size_t window = 64 << dict;
+    const size_t n = data.size();
+    std::vector<int> head(1 << 16, -1);
+    std::vector<int> prev(n, -1);
+    BitWriter out;
+    size_t i = 0;
+    
+    out.put(lit, 8);
+    out.put(dict, 8);
+    
+    //greedy matching on hash chains, good enough to exercise every code
+    while(i < n) {
+        size_t best = 0;
+        size_t dist = 0;
+    
+        if(i + 3 <= n) {
+            int cand = head[hash3(&data[i])];
+    
+            for(unsigned tries = 0; cand >= 0 && i - cand <= window && tries < MAX_TRIES; tries++) {
+                size_t len = 0;
+    
+                while(len < MAX_MATCH && i + len < n && data[cand + len] == data[i + len]) len++;
+    
+                if(len > best) {
+                    best = len;
+                    dist = i - cand;
+                }
+    
+                cand = prev[cand];
+            }
+        }
+    
+        //two byte matches only reach back 256 bytes
+        if(best < 3) {
+            best = 0;
+    
+            for(size_t d = 1; i + 2 <= n && d <= 256 && d <= i; d++) {
+                if(data[i - d] == data[i] && data[i - d + 1] == data[i + 1]) {
+                    best = 2;
+                    dist = d;
+                    break;
+                }
+            }
+        }
+    
+        if(best) {
+            putMatch(out, best, dist, dict);
+        } else {
+            putLiteral(out, data[i], lit);
+            best = 1;
+        }
+    
+        for(size_t end = i + best; i < end; i++) {
+            if(i + 3 <= n) {
+                unsigned h = hash3(&data[i]);
+    
+                prev[i] = head[h];
+                head[h] = i;
+            }
+        }
+    }
+    
+    putEnd(out);
+    
+    return out.finish();
+}
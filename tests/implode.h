@@ -0,0 +1,73 @@
+/*
+ * File:   implode.h
+ *
+ * DCL encoder for the tests and benchmarks, the counterpart of blast().
+ */
+
+#ifndef IMPLODE_H
+#define	IMPLODE_H
+
+#include <vector>
+
+#ifdef _WIN32
+#include "../src/win32/stdint.h"
+#else
+#include <stdint.h>
+#endif
+
+typedef std::vector<unsigned char> t_stream;
+
+struct t_code {
+    unsigned code;
+    int len;
+};
+
+//bits go out least significant first, as blast's bits() takes them
+class BitWriter
+{
+public:
+    BitWriter() : m_acc(0), m_bits(0) {}
+    
+    void put(unsigned value, int bits)
+    {
+        m_acc |= (value & ((1u << bits) - 1)) << m_bits;
+        m_bits += bits;
+    
+        while(m_bits >= 8) {
+            m_buf.push_back(m_acc & 0xFF);
+            m_acc >>= 8;
+            m_bits -= 8;
+        }
+    }
+    
+    //huffman codes are stored first bit first and inverted
+    void code(const t_code& c)
+    {
+        for(int i = c.len - 1; i >= 0; i--) {
+            put(((c.code >> i) & 1) ^ 1, 1);
+        }
+    }
+    
+    t_stream& finish()
+    {
+        if(m_bits) put(0, 8 - m_bits);
+    
+        return m_buf;
+    }
+private:
+    t_stream m_buf;
+    uint32_t m_acc;
+    int m_bits;
+};
+
+//write a match, a literal coded if lit, or the end code, for building streams
+//by hand
+void putMatch(BitWriter& out, unsigned len, unsigned dist, int dict);
+void putLiteral(BitWriter& out, unsigned char c, int lit);
+void putEnd(BitWriter& out);
+
+//encode data as a DCL stream with coded literals if lit and a dictionary of
+//64 << dict bytes, dict being 4, 5 or 6
+t_stream implode(const t_stream& data, int lit, int dict);
+
+#endif	/* IMPLODE_H */